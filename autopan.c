@@ -1,378 +1,238 @@
 /*
 AME 262 Final Project -- Auto-panner
 Author: Lindsey Deng
-Support input file with the following extensions: .wav, .aif, .aiff 
+Support input file with the following extensions: .wav, .aif, .aiff, .w64
 The input file has to be mono.
 This program uses low frequency oscillator(LFOs) to pan the input file.
 This program outputs a stereo audio file with processed panning. 
 The user can specify the width, rate, phase, and type of panning.
-Compile(MacOS M1): gcc autopan.c breakpoints.c -o autopan -Iinclude -Llib -lsndfile
+Compile(MacOS M1): make
 Sample runs:
 ./autopan Salinas.wav Salinas_sine.wav 0.75 1 3 sine
+./autopan --threads=4 --batch=jobs.txt
 Adapted from sfpan.c by Minglun Lee
-constpower function written by Richard Dobson
+constpower function written by Richard Dobson (see pan.c)
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-#include <math.h>      // for sin, cos, atan, sqrt
-#include <sndfile.h>   
-#include <breakpoints.h>
+#include <unistd.h>   // for dup
+#include <autopan.h>   // libautopan: all the rendering is there
 #include<time.h>
 
-#define NFRAMES (1024)  // block size: number of frames per block
-
 
 //function prototypes
 void print_sfinfo(const SF_INFO * sfinfo); // print sfinfo to the console
-int  sf_extension(const char * filename);  // determine the major format with the file extension (e.g. wav, aif, aiff).
 
 
 // for command line arguments
 enum{ARG_PROGNAME,ARG_INFILE,ARG_OUTFILE,ARG_WIDTH,ARG_RATE,ARG_PHASE,ARG_TYPE,ARG_NARGS};
 
-//for indices for panning types
-enum{SINE,SQUARE,SAWTOOTH,TRIANGLE,RANDOM};
-
-//command line arguments for panning types
-char *panning_types[] = {"sine","square","sawtooth","triangle","random"};
-
-typedef struct panamps{
-    double left;          // amp to the left channel
-    double right;         // amp to the right channel
-} PANAMPS;                // panning amplitudes
-
-PANAMPS constpower(double position); // constant power function
-
 
 int main (int argc, char * argv [])
 {
-   char * infilename;         // input file name
-   char * outfilename;        // output file name
-   SNDFILE * infile = NULL;   // input sound file pointer
-   SNDFILE * outfile = NULL;  // output sound file pointer
-   SF_INFO sfinfo;            // sound file info
-   int outfile_major_type;    // output major type in hex
-   long readcount;            // no. of samples read
-   float * inbuffer = NULL;   // buffer for input file
-   float * outbuffer = NULL;  // buffer for output file
-   FILE * fp = NULL;          // for breakpoint file
-   BREAKPOINT * points = NULL;    // breakpoint structure
-   //double  sampletime = 0.0;  // sample time from t = 0
-   //double  timeincr;          // time increment = 1/SR
-   double  width;            // width of panning
-   double  rate;              // rate of panning in Hz
-   double  phase;             // phase of panning in radius per sample
-   double duration;           // duration of the audio file
-   int     panning_type;      // panning type
-   double lfo_freq;           // frequency of the LFO
-   double lfo_dur;            // duration of the LFO
-   double lfo_phase;          // phase of the LFO 
-   double lfo_amp;            // amplitude of the LFO
-   double sampletime;         // sample time from t = 0
-   double timeincr;           // time increment = 1/SR
-   PANAMPS panamps;           // panning amplitudes
-   srand(time(NULL));         // seed for random number generator
-
-
+   char * progname;           // program name
+   char * shapename = NULL;   // optional custom LFO shape file
+   char * manifest = NULL;    // optional batch manifest
+   FILE * fp = NULL;          // for the shape file
+   WAVETABLE * shape = NULL;  // custom LFO shape
+   AUTOPANJOB job;            // settings of the render
+   PANBUFFERS buffers;        // block buffers
+   long nframes = NFRAMES;    // block size; 0 to auto-tune it
+   RENDERSTATS stats;         // times of the stages for --stats
+   int statsmode = 0;         // --stats: 1 for a table, 2 for JSON
+   int result;
+   stats_start(&stats);       // setup time counts from here
+   pan_init();                // pick the fastest pan kernel for this CPU
+   wt_get(SINE, 0);           // build the wavetables before any threads start
+
+   memset(&job, 0, sizeof(job));
+   job.nthreads = 1;
+   job.seed = (unsigned long)time(NULL);  // a new random pan unless --seed is given
+
+   // optional flags come before the other arguments
+   progname = argv[ARG_PROGNAME];
+   while(argc > 1 && strncmp(argv[1], "--", 2) == 0)
+   {
+        if(strncmp(argv[1], "--export=", 9) == 0 && argv[1][9] != '\0')
+            job.exportname = argv[1] + 9;
+        else if(strncmp(argv[1], "--shape=", 8) == 0 && argv[1][8] != '\0')
+            shapename = argv[1] + 8;
+        else if(strcmp(argv[1], "--smooth") == 0)
+            job.smooth = 1;
+        else if(strncmp(argv[1], "--threads=", 10) == 0)
+        {
+            job.nthreads = atoi(argv[1] + 10);
+            if(job.nthreads < 1 || job.nthreads > MAXTHREADS)
+            {
+                printf("Error: threads must be between 1 and %d.\n", MAXTHREADS);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[1], "--pipeline") == 0)
+            job.pipeline = 1;
+        else if(strcmp(argv[1], "--mmap") == 0)
+            job.mmap = 1;
+        else if(strcmp(argv[1], "--integer") == 0)
+            job.intpcm = 1;
+        else if(strncmp(argv[1], "--seed=", 7) == 0)
+        {
+            char * end;
+            job.seed = strtoul(argv[1] + 7, &end, 10);
+            if(argv[1][7] == '\0' || *end != '\0')
+            {
+                printf("Error: --seed needs a number, e.g. --seed=42\n");
+                return 1;
+            }
+        }
+        else if(strncmp(argv[1], "--raw=", 6) == 0)
+        {
+            char format[8] = "s16";
+            if(sscanf(argv[1] + 6, "%d:%7s", &job.rawrate, format) < 1 || job.rawrate <= 0
+               || (job.rawformat = raw_subtype(format)) == 0)
+            {
+                printf("Error: --raw needs a sample rate and optionally s16, s24, s32 or f32, e.g. --raw=44100:s16\n");
+                return 1;
+            }
+        }
+        else if(strcmp(argv[1], "--stats") == 0)
+            statsmode = 1;
+        else if(strcmp(argv[1], "--stats=json") == 0)
+            statsmode = 2;
+        else if(strcmp(argv[1], "--blocksize=auto") == 0)
+            nframes = 0;
+        else if(strncmp(argv[1], "--blocksize=", 12) == 0)
+        {
+            nframes = atol(argv[1] + 12);
+            if(nframes < MINFRAMES || nframes > MAXFRAMES)
+            {
+                printf("Error: block size must be between %d and %d frames.\n", MINFRAMES, MAXFRAMES);
+                return 1;
+            }
+        }
+        else if(strncmp(argv[1], "--batch=", 8) == 0 && argv[1][8] != '\0')
+            manifest = argv[1] + 8;
+        else
+        {
+            printf("Error: unknown option %s\n", argv[1]);
+            return 1;
+        }
+        argc--;
+        argv++;
+   }
 
    //input validation
-    if(argc != ARG_NARGS)
+    if(manifest != NULL ? argc != 1 : argc != ARG_NARGS)
     {
         printf("--------------------WELCOME TO AUTO-PANNER--------------------\n");
         printf("Auto-panner: Automatically pan your audio file!\n");
-        printf("Usage: %s infile outfile width rate phase type\n" , argv[ARG_PROGNAME]);
+        printf("Usage: %s [options] infile outfile width rate phase type\n" , progname);
+        printf("       %s [options] --batch=manifest\n" , progname);
         printf("infile: input file name\n");
         printf("outfile: output file name\n");
         printf("width: amplitude of the LFO: (0.0 - 1.0)\n");
         printf("rate: rate of the LFO in Hz: (0.0 - 10.0)\n");
         printf("phase: phase of the LFO in radians: (0.0 - 2*pi)\n");
         printf("type: panning type: sine, square,sawtooth, triangle,random\n");
+        printf("options:\n");
+        printf("--export=file: also write the LFO breakpoints to a text file (binary for .brk)\n");
+        printf("--smooth: band-limited square, sawtooth and triangle (no clicks)\n");
+        printf("--shape=file: read the LFO shape (one cycle) from a breakpoint file\n");
+        printf("--threads=n: render on n threads (not with --export)\n");
+        printf("--pipeline: read, pan and write on three threads at once\n");
+        printf("--mmap: read and write 16-bit or float WAV files through memory maps\n");
+        printf("--integer: pan 16, 24 and 32-bit PCM as integers, within one step of float (one thread)\n");
+        printf("--seed=n: seed of the random type, for the same pan on every run\n");
+        printf("--raw=rate[:format]: the input is headerless mono, format s16 (default), s24, s32 or f32\n");
+        printf("infile - reads stdin, outfile - writes stdout (AU, or raw for raw input)\n");
+        printf("--stats[=json]: time each stage and report the realtime factor\n");
+        printf("--blocksize=n: frames per block (default %d), or auto to time a few sizes\n", NFRAMES);
+        printf("--batch=manifest: render the jobs of a manifest, one per line:\n");
+        printf("    infile outfile width rate phase type\n");
+        printf("    --threads sets the number of jobs rendered at once\n");
         printf("--------------------------------------------------------------\n");
         return 1;
     }
 
-    infilename = argv[ARG_INFILE];
-    outfilename = argv[ARG_OUTFILE];
-
-
-    // check if the input file name and output file name are the same
-    if(strcmp(infilename, outfilename) == 0)
-    {
-        printf("Error: input file name and output file name cannot be the same.\n");
-        return 1;
-    }
-
-    // validate the width
-   width = atof(argv[ARG_WIDTH]);
-    if(width < 0.5 ||width > 1.0)
-    {
-        printf("Error: amount must be between 0.5 and 1.0.\n");
-        return 1;
-    }
-
-    // validate the rate
-    rate = atof(argv[ARG_RATE]);
-    if(rate < 0.0 || rate > 10)
+    if(job.pipeline && job.nthreads > 1 && manifest == NULL)
     {
-        printf("Error: rate must be between 0.0 and 10.0\n");
+        printf("Error: --pipeline can't be used with --threads.\n");
         return 1;
     }
 
-    // validate the phase
-    phase = atof(argv[ARG_PHASE]);
-    if(phase < 0.0 || phase > 2*M_PI)
+    if(manifest == NULL)
     {
-        printf("Error: phase must be between 0.0 and 2*pi.\n");
-        return 1;
-    }
-
-    // validate the panning type
-    panning_type = -1;
-    for(int i = 0; i < 5; i++)
-    {
-        if(strcmp(argv[ARG_TYPE], panning_types[i]) == 0)
+        job.infilename = argv[ARG_INFILE];
+        job.outfilename = argv[ARG_OUTFILE];
+        job.width = atof(argv[ARG_WIDTH]);
+        job.rate = atof(argv[ARG_RATE]);
+        job.phase = atof(argv[ARG_PHASE]);
+        if(check_params(job.width, job.rate, job.phase, argv[ARG_TYPE], &job.type) != 0)
+            return 1;
+        if(strcmp(job.outfilename, "-") == 0)
         {
-            panning_type = i;
-            break;
+            // stdout carries the audio; messages go to stderr from here on
+            fflush(stdout);
+            job.outfd = dup(STDOUT_FILENO);
+            if(job.outfd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+            {
+                printf("Error: unable to write to stdout.\n");
+                return 1;
+            }
         }
     }
-
-    if(panning_type == -1)
-    {
-        printf("Error: panning type must be sine, sawtooth, or random.\n");
-        return 1;
-    }
-
-    //open the sound file for reading
-    memset(&sfinfo, 0, sizeof(sfinfo)); // clear the SF_INFO struct
-    if((infile = sf_open(infilename, SFM_READ, &sfinfo)) == NULL)
+    else if(job.exportname != NULL || statsmode)
     {
-       printf("Not able to open input file %s.\n", infilename) ;
-       puts(sf_strerror (NULL));
-       free(points);
-        fclose(fp);    // close the breakpoint file
+        printf("Error: %s can't be used with --batch.\n", statsmode ? "--stats" : "--export");
         return 1;
     }
 
-    //calcuate duration of the sound file
-    duration = (double)sfinfo.frames / (double)sfinfo.samplerate; 
-    lfo_freq = rate;
-    lfo_dur = duration;
-    lfo_phase = phase;
-    lfo_amp = width;
-    double num_samples = lfo_dur * sfinfo.samplerate;
-
-    double period = 1.0 /(double) lfo_freq;
-    double phase_offset = phase * period;
-    
-    //sine lfo
-    if(panning_type == SINE)
+    if(shapename != NULL)
     {
-        FILE *file = fopen("panpos.txt", "w");
-        if (file == NULL) {
-        printf("Error: unable to open file\n");
-        return 1;
-         }
-        for(int i=0; i<num_samples; i+=1000)
-        {
-            double time = (double)i / (double)sfinfo.samplerate;
-            double value = lfo_amp * sin(2*M_PI*lfo_freq*time + lfo_phase);
-            fprintf(file, "%f %f\n", time, value);
+        // a custom shape replaces the waveform of the panning type
+        if((fp = fopen(shapename, "r")) == NULL){
+            printf("Error: unable to open shape file %s\n", shapename);
+            return 1;
         }
-
-        fclose(file);
-    }
-
-    //square lfo
-    if(panning_type == SQUARE)
-    {
-        FILE *file = fopen("panpos.txt", "w");
-        if (file == NULL) {
-        printf("Error: unable to open file\n");
-        return 1;
-         }
-        for(int i=0; i<num_samples; i+=1000)
-        {
-            double time = (double)i / (double)sfinfo.samplerate;
-            double value = fmod(time + phase_offset, period) / period < 0.5 ? lfo_amp : -lfo_amp; 
-            fprintf(file, "%f %f\n", time, value);
-        }
-
-        fclose(file);
-    }
-
-    //sawtooth lfo
-    if(panning_type ==SAWTOOTH)
-    {
-        FILE *file = fopen("panpos.txt", "w");
-        if (file == NULL) {
-        printf("Error: unable to open file\n");
-        return 1;
-     }
-
-      for (int i = 0; i < num_samples; i+=1000) {
-        double time = (double)i / (double)sfinfo.samplerate ;
-        double value = (2.0 * lfo_amp / period) * (fmod(time + phase_offset, period) - 0.5 * period);  // calculate sawtooth value
-        fprintf(file, "%lf %lf\n", time, value);
-       }
-
-         fclose(file);
-
-    }
-
-    //triangle lfo
-    if(panning_type == TRIANGLE)
-    {
-        FILE *file = fopen("panpos.txt", "w");
-        if (file == NULL) {
-        printf("Error: unable to open file\n");
-        return 1;
-     }
-
-      for (int i = 0; i < num_samples; i+=1000) {
-        double time = (double)i / (double)sfinfo.samplerate;
-        double value = (2*lfo_amp/M_PI)*asin(sin(2*M_PI*lfo_freq*time + phase_offset));
-        fprintf(file, "%lf %lf\n", time, value);
-       }
-
-         fclose(file);
-
-    }
-
-    //random lfo
-    if(panning_type == RANDOM)
-    {
-        FILE *file = fopen("panpos.txt", "w");
-        if (file == NULL) {
-        printf("Error: unable to open file\n");
-        return 1;
-     }
-
-      for (int i = 0; i < num_samples; i+=1000) {
-        double time = (double)i / sfinfo.samplerate;
-        double value = ((double)rand() / RAND_MAX) * (2.0 * lfo_amp) - lfo_amp;
-        fprintf(file, "%lf %lf\n", time, value);
-       }
-
-         fclose(file);
-
-    }
-
-    //open the generated breakpoint file for reading
-    if((fp = fopen("panpos.txt", "r")) == NULL)
-    {
-        printf("Not able to open breakpoint file.\n");
-        free(points);
-        sf_close(infile);
-        return 1;
-    }
-    unsigned long size = 0;
-    points = get_breakpoints(fp, &size);
-    if(points == NULL){
-        printf("Error: No breakpoints read.\n");
+        shape = wt_load(fp);
         fclose(fp);
-        return 1;
-    }
-    if(size < 2){
-        printf("Error: at least two breakpoints required\n");
-        free(points);
-        fclose(fp);
-        return 1;
-    }
-    /* we require breakpoints to start from 0 */
-    if(points[0].time != 0.0){
-        printf("Error in breakpoint data: first time must be 0.0\n");
-        free(points);
-        fclose(fp);
-        return 1;
+        if(shape == NULL){
+            printf("Error: unable to read shape file %s\n", shapename);
+            return 1;
+        }
+        job.shape = shape;
     }
 
-     memset(&sfinfo, 0, sizeof (sfinfo));  // clear sfinfo
+    if(nframes == 0)
+        nframes = tune_blocksize();
 
-        /* Open input sound file  for reading &
-     fill sound file information with sfinfo. */
-    if((infile = sf_open(infilename, SFM_READ, &sfinfo)) == NULL)
+    if(manifest != NULL)
     {
-        printf("Not able to open input file %s.\n", infilename) ;
-        puts(sf_strerror (NULL));
-        free(points);
-        fclose(fp);    // close the breakpoint file
-        return 1;
-    }
-    
-    if(sfinfo.channels != 1){
-        printf("Error: Input file is not mono!\n");
-        fclose(fp);
-        free(points);
-        sf_close(infile);
-        return 1;
-    }
-
-
-    timeincr = 1.0/sfinfo.samplerate;     // sample time increment
-    
-    inbuffer = (float *)malloc(NFRAMES * sizeof(float)); // used to save a block of samples
-    outbuffer = (float *)malloc(2 * NFRAMES * sizeof(float)); // for stereo
-    outfile_major_type = sf_extension(outfilename); // return outfile major type in hex
-    if(outfile_major_type == -1){
-        printf("The outfile extension is not .wav, .aif, or .aiff\n");
-        free(inbuffer);
-        free(outbuffer);
-        free(points);
-        sf_close(infile);
-        return 1;
+        // the jobs run one per thread
+        result = run_batch(manifest, &job, job.nthreads, nframes);
+        free(shape);
+        return result;
     }
-    
-    sfinfo.channels = 2; // stereo for output file
 
-     if(!sf_format_check(&sfinfo))  // check sfinfo for outfile
+    if(panbuffers_alloc(&buffers, nframes) != 0)
     {
-        printf ("Invalid encoding\n") ;
-        free(inbuffer);
-        free(outbuffer);
-        free(points);
-        sf_close(infile) ;
+        printf("Error: out of memory\n");
+        free(shape);
         return 1;
     }
-    
-    // open a sound file for writing with sfinfo
-    if((outfile = sf_open(outfilename, SFM_WRITE, &sfinfo)) == NULL)
-    {
-        printf("Not able to open output file %s.\n", outfilename) ;
-        puts(sf_strerror (NULL));
-        free(inbuffer);
-        free(outbuffer);
-        free(points);
-        sf_close(infile) ;
-        return 1 ;
-    }
-
-    //processing autopanning 
-        while ((readcount = sf_read_float(infile, inbuffer, NFRAMES)) > 0){
-        double stereopos;  
-        
-        for(int i = 0, out_i = 0; i < readcount; i++){
-            // get the stereo position at the current sample time
-            stereopos = val_at_brktime(points, size, sampletime); 
-            panamps = constpower(stereopos);
-            outbuffer[out_i++] = (float)(inbuffer[i] * panamps.left);
-            outbuffer[out_i++] = (float)(inbuffer[i] * panamps.right);
-            sampletime += timeincr;
-        }
-        sf_write_float(outfile, outbuffer, 2 * readcount) ;
-    }    // read block by block until the end of the sound file
+    if(statsmode)
+        job.stats = &stats;
+    result = render_job(&job, &buffers);
+    if(statsmode && result == 0)
+        stats_print(stdout, &stats, (long long)job.frames, job.samplerate, statsmode == 2);
 
       /* clean up */
-    free(inbuffer);
-    free(outbuffer);
-    free(points);
-    sf_close(infile) ;   // close input sound file
-    sf_close(outfile) ;  // close output text file
+    panbuffers_free(&buffers);
+    free(shape);
     
-    return 0 ;
+    return result ;
 
 }
 
@@ -414,34 +274,3 @@ void print_sfinfo(const SF_INFO * sfinfo){
         }
     }
 }
-
-/*
- Determine the file major type with the file extension (e.g. wav, aif, aiff).
- Return the major type format in hex.
- */
-int sf_extension(const char * filename){
-    int filename_len = strlen(filename); // entire filename length (include the extension)
-    if(strcmp((filename + (filename_len - 4)), ".wav") == 0){
-        return SF_FORMAT_WAV;     // wav file type in hex
-    }
-    else if(strcmp((filename + (filename_len - 4)), ".aif") == 0
-        || strcmp((filename + (filename_len - 5)), ".aiff") == 0){
-        return SF_FORMAT_AIFF;   // aiff or aif file type in hex
-    }
-    else {
-        return -1;               // extension is not wav, aiff, or aif
-    }
-}
-
-PANAMPS constpower(double position)
-{
-    PANAMPS amps;  // amplitudes for left & right channels
-    const double  piovr2    = 4.0 * atan(1.0) * 0.5;    /* pi/2: 1/4 cycle of a sinusoid */
-    const double  root2ovr2 = sqrt(2.0) * 0.5;         /* sqrt(2)/2: 1/4 amplitude of a sinusoid */
-    double thispos = position * piovr2;                    /* scale position to fit the pi/2 range */
-    double angle = thispos * 0.5;                         /* each channel uses a 1/4 of a cycle */
-    
-    amps.left    = root2ovr2 * (cos(angle) - sin(angle));
-    amps.right    = root2ovr2 * (cos(angle) + sin(angle));
-    return amps;
-}
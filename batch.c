@@ -0,0 +1,267 @@
+/*
+batch.c -- batch mode for the auto-panner
+Reads a manifest of jobs and renders them on a work-stealing thread pool.
+Every worker keeps its block buffers for all the jobs it runs.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <batch.h>
+#include <pool.h>
+
+typedef struct batch_job {
+    AUTOPANJOB job;
+    char *  names;       // storage for the file names
+    int     line;        // line in the manifest
+    int     result;      // 0 for success
+    double  seconds;     // wall time of the render
+} BATCHJOB;
+
+typedef struct batch {
+    BATCHJOB *   jobs;
+    PANBUFFERS * buffers;    // one set per worker
+} BATCH;
+
+typedef struct batch_name {
+    const char * name;
+    int          line;       // line of the job in the manifest
+    int          output;     // 1 for an outfile, 0 for an infile
+} BATCHNAME;
+
+static double batch_now(void);                  // monotonic time in seconds
+static void   batch_task(int task, int worker, void * context);
+static int    batch_read(FILE * fp, const AUTOPANJOB * settings, BATCHJOB ** pjobs, int * pnjobs);
+static int    batch_checknames(const BATCHJOB * jobs, int njobs);
+static int    batch_cmpname(const void * a, const void * b);
+
+/*
+ Rendering all the jobs of a manifest file.
+ */
+int run_batch(const char * manifest, const AUTOPANJOB * settings, int nworkers, long nframes)
+{
+    FILE * fp;
+    BATCH batch;
+    int njobs = 0, failed = 0, i;
+    double start, total;
+    sf_count_t frames = 0;
+    double audio = 0.0;
+
+    if((fp = fopen(manifest, "r")) == NULL){
+        printf("Error: unable to open manifest %s\n", manifest);
+        return 1;
+    }
+    i = batch_read(fp, settings, &batch.jobs, &njobs);
+    fclose(fp);
+    if(i != 0)
+        return 1;
+    if(njobs == 0){
+        printf("Error: no jobs in manifest %s\n", manifest);
+        free(batch.jobs);
+        return 1;
+    }
+    if(nworkers > njobs)
+        nworkers = njobs;
+
+    batch.buffers = (PANBUFFERS *)calloc(nworkers, sizeof(PANBUFFERS));
+    for(i = 0; batch.buffers != NULL && i < nworkers; i++){
+        if(panbuffers_alloc(&batch.buffers[i], nframes) != 0)
+            break;
+    }
+    if(batch.buffers == NULL || i < nworkers){
+        printf("Error: out of memory\n");
+        failed = 1;
+    }
+    else {
+        start = batch_now();
+        if(pool_run(nworkers, njobs, batch_task, &batch) != 0){
+            printf("Error: unable to start worker threads\n");
+            failed = 1;
+        }
+        total = batch_now() - start;
+
+        // timing summary, in manifest order
+        printf("%-5s %-6s %12s %10s %10s  %s\n", "line", "status", "frames", "seconds", "realtime", "outfile");
+        for(i = 0; i < njobs && !failed; i++){
+            BATCHJOB * b = &batch.jobs[i];
+            double length = b->job.samplerate > 0 ? (double)b->job.frames / b->job.samplerate : 0.0;
+            printf("%-5d %-6s %12lld %10.3f %9.1fx  %s\n", b->line, b->result == 0 ? "ok" : "FAILED",
+                   (long long)b->job.frames, b->seconds, b->seconds > 0.0 ? length / b->seconds : 0.0,
+                   b->job.outfilename);
+            frames += b->job.frames;
+            audio += length;
+        }
+        for(i = 0; i < njobs && !failed; i++)
+            failed |= batch.jobs[i].result != 0;
+        printf("%d jobs on %d threads: %lld frames in %.3f seconds (%.1fx realtime)\n",
+               njobs, nworkers, (long long)frames, total, total > 0.0 ? audio / total : 0.0);
+    }
+
+    for(i = 0; batch.buffers != NULL && i < nworkers; i++)
+        panbuffers_free(&batch.buffers[i]);
+    free(batch.buffers);
+    for(i = 0; i < njobs; i++)
+        free(batch.jobs[i].names);
+    free(batch.jobs);
+    return failed;
+}
+
+/*
+ Running one job of the batch with the buffers of the worker.
+ */
+static void batch_task(int task, int worker, void * context)
+{
+    BATCH * batch = (BATCH *)context;
+    BATCHJOB * b = &batch->jobs[task];
+    double start = batch_now();
+
+    b->result = render_job(&b->job, &batch->buffers[worker]);
+    b->seconds = batch_now() - start;
+}
+
+/*
+ Reading the jobs of a manifest; every job starts as a copy of settings.
+ Returning 0 for success or 1 for an error in the manifest.
+ */
+static int batch_read(FILE * fp, const AUTOPANJOB * settings, BATCHJOB ** pjobs, int * pnjobs)
+{
+    char line[MANIFEST_LINELENGTH];
+    BATCHJOB * jobs = NULL;
+    int njobs = 0, size = 0, lineno = 0, error = 0;
+
+    while(!error && fgets(line, MANIFEST_LINELENGTH, fp)){
+        char * fields[6];
+        int nfields = 0;
+        char * token;
+        BATCHJOB * b;
+
+        lineno++;
+        for(token = strtok(line, " \t\r\n"); token != NULL && nfields < 6; token = strtok(NULL, " \t\r\n"))
+            fields[nfields++] = token;
+        if(nfields == 0 || fields[0][0] == '#')
+            continue;  // blank line or comment
+        if(nfields != 6 || strtok(NULL, " \t\r\n") != NULL){
+            printf("Error in manifest line %d: expected infile outfile width rate phase type\n", lineno);
+            error = 1;
+            break;
+        }
+        if(njobs == size){
+            BATCHJOB * tmp;
+            size = size ? 2 * size : 64;
+            tmp = (BATCHJOB *)realloc(jobs, size * sizeof(BATCHJOB));
+            if(tmp == NULL){
+                printf("Error: out of memory\n");
+                error = 1;
+                break;
+            }
+            jobs = tmp;
+        }
+        b = &jobs[njobs];
+        memset(b, 0, sizeof(BATCHJOB));
+        b->job = *settings;
+        b->job.nthreads = 1;
+        b->line = lineno;
+        b->job.width = atof(fields[2]);
+        b->job.rate = atof(fields[3]);
+        b->job.phase = atof(fields[4]);
+        if(strcmp(fields[0], "-") == 0 || strcmp(fields[1], "-") == 0){
+            printf("Error in manifest line %d: stdin and stdout can't be used in a batch\n", lineno);
+            error = 1;
+            break;
+        }
+        if(check_params(b->job.width, b->job.rate, b->job.phase, fields[5], &b->job.type) != 0){
+            printf("Error in manifest line %d\n", lineno);
+            error = 1;
+            break;
+        }
+        // keep both names in one allocation
+        b->names = (char *)malloc(strlen(fields[0]) + strlen(fields[1]) + 2);
+        if(b->names == NULL){
+            printf("Error: out of memory\n");
+            error = 1;
+            break;
+        }
+        strcpy(b->names, fields[0]);
+        strcpy(b->names + strlen(fields[0]) + 1, fields[1]);
+        b->job.infilename = b->names;
+        b->job.outfilename = b->names + strlen(fields[0]) + 1;
+        njobs++;
+    }
+    if(!error && batch_checknames(jobs, njobs) != 0)
+        error = 1;
+    if(error){
+        for(int i = 0; i < njobs; i++)
+            free(jobs[i].names);
+        free(jobs);
+        return 1;
+    }
+    *pjobs = jobs;
+    *pnjobs = njobs;
+    return 0;
+}
+
+/*
+ Checking that no two jobs write the same file and no job reads a file
+ another one writes, since the jobs run at the same time. The names are
+ compared as written in the manifest; sorting them puts equal ones next
+ to each other, with the outfile first.
+ Returning 0, or 1 with a message for the first clash.
+ */
+static int batch_checknames(const BATCHJOB * jobs, int njobs)
+{
+    BATCHNAME * names;
+    int i, j, error = 0;
+
+    if(njobs < 2)
+        return 0;
+    if((names = (BATCHNAME *)malloc(2 * (size_t)njobs * sizeof(BATCHNAME))) == NULL){
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    for(i = 0; i < njobs; i++){
+        names[2*i].name = jobs[i].job.outfilename;
+        names[2*i].line = jobs[i].line;
+        names[2*i].output = 1;
+        names[2*i+1].name = jobs[i].job.infilename;
+        names[2*i+1].line = jobs[i].line;
+        names[2*i+1].output = 0;
+    }
+    qsort(names, 2 * (size_t)njobs, sizeof(BATCHNAME), batch_cmpname);
+    for(i = 0; i < 2 * njobs && !error; i = j){
+        for(j = i + 1; j < 2 * njobs && strcmp(names[j].name, names[i].name) == 0; j++){
+            if(!names[i].output || names[j].line == names[i].line)
+                continue;  // only inputs so far, or the job's own names
+            printf("Error in manifest line %d: %s %s is the outfile of line %d\n", names[j].line,
+                   names[j].output ? "outfile" : "infile", names[j].name, names[i].line);
+            error = 1;
+            break;
+        }
+    }
+    free(names);
+    return error;
+}
+
+/* Ordering names by name, the outfiles first, then by line */
+static int batch_cmpname(const void * a, const void * b)
+{
+    const BATCHNAME * x = (const BATCHNAME *)a, * y = (const BATCHNAME *)b;
+    int c = strcmp(x->name, y->name);
+
+    if(c != 0)
+        return c;
+    if(x->output != y->output)
+        return y->output - x->output;
+    return x->line - y->line;
+}
+
+/*
+ Monotonic time in seconds.
+ */
+static double batch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,475 @@
+/*
+bench.c -- benchmarks for the auto-panner
+Microbenchmarks for the breakpoint functions and the panning kernels, and
+end-to-end renders of synthetic 16-bit mono files (1 minute and 1 hour, on
+the float and on the integer path; 10 hours with --long). The results go
+to stdout as JSON, progress to stderr.
+Usage: ./autopan-bench [--long]
+Compile: make bench
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sndfile.h>
+#include <breakpoints.h>
+#include <brksoa.h>
+#include <lfo.h>
+#include <pan.h>
+#include <kernels.h>
+#include <render.h>
+
+#define BENCH_POINTS (100000)     // breakpoints in the breakpoint benchmarks
+#define BENCH_QUERIES (1 << 13)   // random times for val_at_brktime (a linear search)
+#define BENCH_FRAMES (1 << 22)    // frames for the per-frame benchmarks
+#define BENCH_RUNS (5)            // runs per microbenchmark; the fastest counts
+#define BENCH_SRATE (44100)
+
+static double bench_now(void);
+static void   bench_result(const char * name, const char * unit, double ops, double seconds);
+static int    bench_render(const char * name, double seconds, int intpcm, PANBUFFERS * buf);
+
+static double sink;    // results are summed here, so the loops can't be optimized away
+static int    first;   // no comma before the first result of a list
+
+int main(int argc, char * argv[])
+{
+    BREAKPOINT * points, * copy;
+    BRKSTREAM * stream;
+    BRKSOA * soa;
+    FILE * fp;
+    double * times, * pos;
+    float * in, * out, * left, * right;
+    PANBUFFERS buffers;
+    unsigned long npoints = 0, i;
+    double start, best, minval, maxval;
+    int run, result = 0, dolong = argc > 1 && strcmp(argv[1], "--long") == 0;
+
+    pan_init();
+    wt_get(SINE, 0);
+    srand(1);
+    times = (double *)malloc(BENCH_QUERIES * sizeof(double));
+    pos = (double *)malloc(BENCH_FRAMES * sizeof(double));
+    in = (float *)malloc(BENCH_FRAMES * sizeof(float));
+    out = (float *)malloc(2 * BENCH_FRAMES * sizeof(float));
+    left = (float *)malloc(BENCH_FRAMES * sizeof(float));
+    right = (float *)malloc(BENCH_FRAMES * sizeof(float));
+    copy = (BREAKPOINT *)malloc(BENCH_POINTS * sizeof(BREAKPOINT));
+    if(times == NULL || pos == NULL || in == NULL || out == NULL || left == NULL
+       || right == NULL || copy == NULL || panbuffers_alloc(&buffers, NFRAMES) != 0){
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    for(i = 0; i < BENCH_FRAMES; i++){
+        pos[i] = 2.0 * rand() / RAND_MAX - 1.0;
+        in[i] = (float)rand() / RAND_MAX - 0.5f;
+    }
+
+    printf("{\n  \"kernel\": \"%s\",\n  \"blocksize\": %d,\n  \"timestamp\": %ld,\n",
+           pan_kernelname(), NFRAMES, (long)time(NULL));
+    printf("  \"micro\": [");
+    first = 1;
+
+    // a breakpoint file of BENCH_POINTS points, 10 ms apart
+    if((fp = tmpfile()) == NULL){
+        fprintf(stderr, "Error: unable to create a temporary file\n");
+        return 1;
+    }
+    for(i = 0; i < BENCH_POINTS; i++)
+        fprintf(fp, "%f %f\n", i * 0.01, sin(i * 0.1));
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        rewind(fp);
+        start = bench_now();
+        points = get_breakpoints(fp, &npoints);
+        start = bench_now() - start;
+        if(points == NULL || npoints != BENCH_POINTS){
+            fprintf(stderr, "Error: get_breakpoints failed\n");
+            return 1;
+        }
+        if(run < BENCH_RUNS - 1)
+            free(points);
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    fclose(fp);
+    bench_result("get_breakpoints", "point", BENCH_POINTS, best);
+
+    for(i = 0; i < BENCH_QUERIES; i++)
+        times[i] = (double)rand() / RAND_MAX * points[npoints - 1].time;
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_QUERIES; i++)
+            sink += val_at_brktime(points, npoints, times[i]);
+        start = bench_now() - start;
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("val_at_brktime", "call", BENCH_QUERIES, best);
+
+    if((soa = brksoa_new(points, npoints)) == NULL){
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_QUERIES; i++)
+            sink += brksoa_val_at(soa, times[i]);
+        start = bench_now() - start;
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("brksoa_val_at", "call", BENCH_QUERIES, best);
+
+    // the stream takes ownership of its points, so it gets a copy
+    memcpy(copy, points, npoints * sizeof(BREAKPOINT));
+    if((stream = bps_newstream_points(copy, npoints, BENCH_SRATE)) == NULL){
+        fprintf(stderr, "Error: bps_newstream_points failed\n");
+        return 1;
+    }
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        bps_rewind(stream);
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i++)
+            sink += bps_tick(stream);
+        start = bench_now() - start;
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("bps_tick", "tick", BENCH_FRAMES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        bps_rewind(stream);
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i += NFRAMES)
+            bps_tick_block(stream, pos, NFRAMES);
+        start = bench_now() - start;
+        sink += pos[0];
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("bps_tick_block", "tick", BENCH_FRAMES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        bps_getminmax(stream, &minval, &maxval);
+        start = bench_now() - start;
+        sink += minval + maxval;
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("bps_getminmax", "point", npoints, best);
+
+    if(bps_buildindex(stream) != 0){
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_QUERIES; i++){
+            bps_seek(stream, times[i]);
+            sink += bps_tick(stream);
+        }
+        start = bench_now() - start;
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("bps_seek", "call", BENCH_QUERIES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        val_at_brktimes_unsorted(points, npoints, times, pos, BENCH_QUERIES);
+        start = bench_now() - start;
+        sink += pos[0];
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("val_at_brktimes_unsorted", "time", BENCH_QUERIES, best);
+
+    // the same number of times, evenly spread and increasing
+    for(i = 0; i < BENCH_QUERIES; i++)
+        times[i] = (double)i / BENCH_QUERIES * points[npoints - 1].time;
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        val_at_brktimes(points, npoints, times, pos, BENCH_QUERIES);
+        start = bench_now() - start;
+        sink += pos[0];
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("val_at_brktimes", "time", BENCH_QUERIES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        brksoa_getminmax(soa, &minval, &maxval);
+        start = bench_now() - start;
+        sink += minval + maxval;
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("brksoa_getminmax", "point", npoints, best);
+    brksoa_free(soa);
+    bps_freepoints(stream);
+    free(stream);
+    free(points);
+
+    // the positions were overwritten by bps_tick_block
+    for(i = 0; i < BENCH_FRAMES; i++)
+        pos[i] = 2.0 * rand() / RAND_MAX - 1.0;
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i++){
+            PANAMPS amps = constpower(pos[i]);
+            sink += amps.left + amps.right;
+        }
+        start = bench_now() - start;
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("constpower", "call", BENCH_FRAMES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i++){
+            PANAMPS amps = constpower_fast(pos[i]);
+            sink += amps.left + amps.right;
+        }
+        start = bench_now() - start;
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("constpower_fast", "call", BENCH_FRAMES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i += NFRAMES)
+            constpower_block(pos + i, left + i, right + i, NFRAMES);
+        start = bench_now() - start;
+        sink += left[0];
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("constpower_block", "frame", BENCH_FRAMES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i += NFRAMES)
+            pan_interleave(in + i, left + i, right + i, out + 2 * i, NFRAMES);
+        start = bench_now() - start;
+        sink += out[0];
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("pan_interleave", "frame", BENCH_FRAMES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        LFO lfo;
+        lfo_init(&lfo, SINE, 1.0, 1.0, 0.0, BENCH_SRATE);
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i += NFRAMES)
+            pan_block(&lfo, in + i, out + 2 * i, NFRAMES,
+                      buffers.posbuffer, buffers.leftgain, buffers.rightgain);
+        start = bench_now() - start;
+        sink += out[0];
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("pan_block", "frame", BENCH_FRAMES, best);
+
+    // the integer path: Q15 gains and 16-bit interleaving
+    for(i = 0; i < BENCH_FRAMES; i++)
+        ((short *)in)[i] = (short)(rand() % 65536 - 32768);
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i += NFRAMES)
+            constpower_block_q15(pos + i, (short *)left + i, (short *)right + i, NFRAMES);
+        start = bench_now() - start;
+        sink += ((short *)left)[0];
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("constpower_block_q15", "frame", BENCH_FRAMES, best);
+
+    best = 0.0;
+    for(run = 0; run < BENCH_RUNS; run++){
+        start = bench_now();
+        for(i = 0; i < BENCH_FRAMES; i += NFRAMES)
+            pan_interleave_s16((short *)in + i, (short *)left + i, (short *)right + i,
+                               (short *)out + 2 * i, NFRAMES);
+        start = bench_now() - start;
+        sink += ((short *)out)[0];
+        if(best == 0.0 || start < best)
+            best = start;
+    }
+    bench_result("pan_interleave_s16", "frame", BENCH_FRAMES, best);
+    for(i = 0; i < BENCH_FRAMES; i++)
+        in[i] = (float)rand() / RAND_MAX - 0.5f;
+
+    // the fused loops of pan_block, to float and to 16-bit samples
+    for(int outtype = 0; outtype < NKERNELOUTS; outtype++){
+        best = 0.0;
+        for(run = 0; run < BENCH_RUNS; run++){
+            LFO lfo;
+            RENDERKERNEL kernel;
+            lfo_init(&lfo, SINE, 1.0, 1.0, 0.0, BENCH_SRATE);
+            kernel = render_kernel(&lfo, outtype);
+            start = bench_now();
+            for(i = 0; i < BENCH_FRAMES; i += NFRAMES)
+                kernel(&lfo, in + i, out + 2 * i, NFRAMES);
+            start = bench_now() - start;
+            sink += out[0];
+            if(best == 0.0 || start < best)
+                best = start;
+        }
+        bench_result(outtype == KERNEL_FLOAT ? "kernel_sine_float" : "kernel_sine_pcm16",
+                     "frame", BENCH_FRAMES, best);
+    }
+    printf("\n  ],\n");
+
+    // end-to-end renders of synthetic files
+    printf("  \"render\": [");
+    first = 1;
+    result |= bench_render("render_1min", 60.0, 0, &buffers);
+    result |= bench_render("render_1min_integer", 60.0, 1, &buffers);
+    result |= bench_render("render_1h", 3600.0, 0, &buffers);
+    result |= bench_render("render_1h_integer", 3600.0, 1, &buffers);
+    if(dolong)
+        result |= bench_render("render_10h", 36000.0, 0, &buffers);
+    printf("\n  ]\n}\n");
+    fprintf(stderr, "(checksum %g)\n", sink);
+
+    panbuffers_free(&buffers);
+    free(times);
+    free(pos);
+    free(in);
+    free(out);
+    free(left);
+    free(right);
+    return result;
+}
+
+/*
+ Printing one microbenchmark result: ops operations of the unit took seconds.
+ */
+static void bench_result(const char * name, const char * unit, double ops, double seconds)
+{
+    printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %.0f, \"seconds\": %.6f, "
+           "\"ns_per_op\": %.3f}",
+           first ? "" : ",", name, unit, ops, seconds, seconds / ops * 1e9);
+    fprintf(stderr, "%-18s %10.3f ns/%s\n", name, seconds / ops * 1e9, unit);
+    first = 0;
+}
+
+/*
+ Rendering a synthetic 16-bit mono file of the given length with a sine LFO,
+ timing the render (the file is written before the clock starts).
+ Returning 0 for success or 1.
+ */
+static int bench_render(const char * name, double seconds, int intpcm, PANBUFFERS * buf)
+{
+    char inname[1024], outname[1024 + 16];
+    const char * tmpdir = getenv("TMPDIR");
+    sf_count_t frames = (sf_count_t)(seconds * BENCH_SRATE), frame;
+    AUTOPANJOB job;
+    SF_INFO sfinfo;
+    SNDFILE * file;
+    double start;
+    int fd, result, written = 1;
+
+    if(tmpdir == NULL || tmpdir[0] == '\0')
+        tmpdir = "/tmp";
+    snprintf(inname, sizeof(inname), "%s/autopan-benchXXXXXX", tmpdir);
+    if((fd = mkstemp(inname)) < 0){
+        fprintf(stderr, "Error: unable to create a file in %s\n", tmpdir);
+        return 1;
+    }
+    close(fd);
+    snprintf(outname, sizeof(outname), "%s.out.w64", inname);
+
+    fprintf(stderr, "%s: writing %lld frames...\n", name, (long long)frames);
+    memset(&sfinfo, 0, sizeof(sfinfo));
+    sfinfo.samplerate = BENCH_SRATE;
+    sfinfo.channels = 1;
+    // Sony Wave64, since the 10 hour output is past the 4 GB limit of WAV
+    sfinfo.format = SF_FORMAT_W64 | SF_FORMAT_PCM_16;
+    if((file = sf_open(inname, SFM_WRITE, &sfinfo)) == NULL){
+        fprintf(stderr, "Error: unable to write %s\n", inname);
+        remove(inname);
+        return 1;
+    }
+    for(frame = 0; frame < frames && written; frame += buf->nframes){
+        long n = frames - frame < buf->nframes ? (long)(frames - frame) : buf->nframes;
+        for(long i = 0; i < n; i++)
+            buf->inbuffer[i] = (float)(0.5 * sin(2.0 * M_PI * 440.0 * (frame + i) / BENCH_SRATE));
+        written = sf_write_float(file, buf->inbuffer, n) == n;
+    }
+    sf_close(file);
+    if(!written){
+        fprintf(stderr, "Error: unable to write %s\n", inname);
+        remove(inname);
+        return 1;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.infilename = inname;
+    job.outfilename = outname;
+    job.width = 1.0;
+    job.rate = 1.0;
+    job.type = SINE;
+    job.nthreads = 1;
+    job.intpcm = intpcm;
+    start = bench_now();
+    result = render_job(&job, buf);
+    start = bench_now() - start;
+    // render_job counts the frames read; the output has to have all of them too
+    memset(&sfinfo, 0, sizeof(sfinfo));
+    if((file = sf_open(outname, SFM_READ, &sfinfo)) == NULL || sfinfo.frames != frames)
+        result = 1;
+    if(file != NULL)
+        sf_close(file);
+    remove(inname);
+    remove(outname);
+    if(result != 0 || job.frames != frames){
+        fprintf(stderr, "Error: %s failed\n", name);
+        return 1;
+    }
+
+    printf("%s\n    {\"name\": \"%s\", \"audio_seconds\": %.0f, \"frames\": %lld, "
+           "\"seconds\": %.3f, \"frames_per_second\": %.0f, \"realtime\": %.1f}",
+           first ? "" : ",", name, seconds, (long long)frames, start, frames / start,
+           seconds / start);
+    fprintf(stderr, "%-18s %10.3f s (%.1fx realtime)\n", name, start, seconds / start);
+    first = 0;
+    return 0;
+}
+
+/*
+ Monotonic time in seconds.
+ */
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
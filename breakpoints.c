@@ -24,8 +24,19 @@ OTHER DEALINGS IN THE SOFTWARE.
 // Updated and commented by Ming-Lun Lee (Spring 2022)
 
 /* basic breakpoint text file support */
+#if !defined(__APPLE__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE	// strtod_l
+#endif
 #include <breakpoints.h>
 #include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <pthread.h>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #ifndef MIN
 #define MIN(x,y) ((x) < (y) ? (x) : (y))
@@ -126,6 +137,390 @@ double val_at_brktime(const BREAKPOINT * points, unsigned long npoints, double t
 	return val; // return the calculated value at the requested time.
 }
 
+/* Finding the span containing a specified time with a binary search.
+   Returns the index i of the first breakpoint (i >= 1) with time <= points[i].time,
+   i.e. the right point of the span, the same one val_at_brktime scans for.
+   Returns npoints if time is beyond the end of the data.
+*/
+unsigned long brk_findspan(const BREAKPOINT * points, unsigned long npoints, double time)
+{
+	unsigned long lo = 1, hi = npoints, mid;
+
+	while(lo < hi){
+		mid = lo + (hi - lo) / 2;
+		if(time <= points[mid].time)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+/* Checking if span i is the one brk_findspan would return for this time */
+static int brk_inspan(const BREAKPOINT * points, unsigned long npoints, double time, unsigned long i)
+{
+	if(i == npoints)
+		return time > points[npoints-1].time;
+	if(i > npoints)
+		return 0;
+	return time <= points[i].time && (i == 1 || time > points[i-1].time);
+}
+
+/* Same as val_at_brktime, but resumes from the span found by the previous call.
+   unsigned long *pspan: the right point of the last span; set it to 1 before the first call.
+   For increasing times this costs O(1) per call, since we normally stay in the same span
+   or move to the next one. Any other jump (a seek) falls back to a binary search.
+*/
+double val_at_brktime_from(const BREAKPOINT * points, unsigned long npoints, double time, unsigned long * pspan)
+{
+	unsigned long i = *pspan;
+	BREAKPOINT left, right;
+	double width;
+
+	if(i < 1 || i > npoints)
+		i = 1;
+	/* is the cached span still the right one? if not, try the next one before searching */
+	if(!brk_inspan(points, npoints, time, i)){
+		if(brk_inspan(points, npoints, time, i + 1))
+			i++;
+		else
+			i = brk_findspan(points, npoints, time);
+	}
+	*pspan = i;
+
+	/* maintain final value if time beyond end of data */
+	if(i == npoints)
+		return points[i-1].value;
+	left  = points[i-1];
+	right = points[i];
+	width = right.time - left.time;
+	if(width == 0.0)     // instant jump
+		return right.value;
+	return left.value + ((right.value - left.value) * ((time - left.time) / width));
+}
+
+/* The value at a time in span i (as brk_findspan), the same as val_at_brktime */
+static double brk_spanvalue(const BREAKPOINT * points, unsigned long npoints, unsigned long i, double time)
+{
+	double width;
+
+	/* maintain final value if time beyond end of data */
+	if(i >= npoints)
+		return points[npoints-1].value;
+	width = points[i].time - points[i-1].time;
+	if(width == 0.0)     // instant jump
+		return points[i].value;
+	return points[i-1].value + ((points[i].value - points[i-1].value) * ((time - points[i-1].time) / width));
+}
+
+/* Finding the values at many times in one pass: the span of each time is
+   searched from the span of the one before, like merging two sorted lists.
+*/
+void val_at_brktimes(const BREAKPOINT * points, unsigned long npoints, const double * times, double * out, unsigned long m)
+{
+	unsigned long i = 1, k;
+
+	for(k = 0; k < m; k++){
+		if(k > 0 && !(times[k] >= times[k-1]))	// going back (or NaN): search again
+			i = brk_findspan(points, npoints, times[k]);
+		while(i < npoints && !(times[k] <= points[i].time))
+			i++;
+		out[k] = brk_spanvalue(points, npoints, i, times[k]);
+	}
+}
+
+/* a time of val_at_brktimes_unsorted with its position in the output */
+typedef struct brk_query {
+	double			time;
+	unsigned long	k;
+} BRKQUERY;
+
+/* Ordering queries by time; NaN goes last, so the order is always consistent */
+static int brk_cmpquery(const void * a, const void * b)
+{
+	double x = ((const BRKQUERY *) a)->time, y = ((const BRKQUERY *) b)->time;
+
+	if(x < y)
+		return -1;
+	if(x > y)
+		return 1;
+	return (x != x) - (y != y);
+}
+
+/* Sorting the times with their positions, then one pass like val_at_brktimes */
+int val_at_brktimes_unsorted(const BREAKPOINT * points, unsigned long npoints, const double * times, double * out, unsigned long m)
+{
+	BRKQUERY * queries;
+	unsigned long i = 1, k;
+
+	if(m == 0)
+		return 0;
+	queries = (BRKQUERY *) malloc(sizeof(BRKQUERY) * m);
+	if(queries == NULL)
+		return -1;
+	for(k = 0; k < m; k++){
+		queries[k].time = times[k];
+		queries[k].k = k;
+	}
+	qsort(queries, m, sizeof(BRKQUERY), brk_cmpquery);
+	for(k = 0; k < m; k++){
+		while(i < npoints && !(queries[k].time <= points[i].time))
+			i++;
+		out[queries[k].k] = brk_spanvalue(points, npoints, i, queries[k].time);
+	}
+	free(queries);
+	return 0;
+}
+
+/* Building the index of a set of breakpoints: a merge of the bucket times
+   with the point times, so each bucket gets the span its first time is in.
+*/
+int brk_buildindex(BRKINDEX * index, const BREAKPOINT * points, unsigned long npoints)
+{
+	unsigned long b, i = 1;
+	double span;
+
+	index->first = NULL;
+	if(points == NULL || npoints == 0)
+		return -1;
+	index->start	= points[0].time;
+	span			= points[npoints-1].time - points[0].time;
+	index->nbuckets	= span > 0.0 ? npoints : 1;
+	index->scale	= span > 0.0 ? index->nbuckets / span : 0.0;
+	index->first	= (unsigned long *) malloc(sizeof(unsigned long) * index->nbuckets);
+	if(index->first == NULL)
+		return -1;
+	for(b = 0; b < index->nbuckets; b++){
+		double time = index->scale > 0.0 ? index->start + b / index->scale : index->start;
+		while(i < npoints && !(time <= points[i].time))
+			i++;
+		index->first[b] = i;
+	}
+	return 0;
+}
+
+/* Releasing the buckets of an index */
+void brk_freeindex(BRKINDEX * index)
+{
+	free(index->first);
+	index->first = NULL;
+	index->nbuckets = 0;
+}
+
+/* Finding the span with the index: the bucket gives the span of a time at
+   or just before ours, which we scan forward from. Rounding can put a time
+   at the very start of a bucket into the previous one, hence the step back.
+*/
+unsigned long brk_findspan_index(const BRKINDEX * index, const BREAKPOINT * points, unsigned long npoints, double time)
+{
+	unsigned long i;
+	double x = (time - index->start) * index->scale;
+
+	if(!(x > 0.0))			// before the first point (or NaN: scan from the start)
+		i = 1;
+	else if(x >= (double) index->nbuckets)
+		i = index->first[index->nbuckets-1];
+	else
+		i = index->first[(unsigned long) x];
+	while(i > 1 && time <= points[i-1].time)
+		i--;
+	while(i < npoints && !(time <= points[i].time))
+		i++;
+	return i;
+}
+
+/* The C locale for strtod_l, made once */
+static locale_t brk_clocale = (locale_t) 0;
+static pthread_once_t brk_clocale_once = PTHREAD_ONCE_INIT;
+
+static void brk_newclocale(void)
+{
+	brk_clocale = newlocale(LC_ALL_MASK, "C", (locale_t) 0);
+}
+
+/* Parsing a number like strtod in the C locale; returning a pointer past it,
+   or NULL if there is none. Most numbers in breakpoint files are short
+   decimals: up to 19 significant digits and a power of ten up to 22 are
+   exact in a double, so one multiply or divide gives the correctly rounded
+   value, the same one strtod gives. Anything else goes to strtod_l with the
+   C locale, so a decimal comma locale set by the program changes nothing. */
+static const char * brk_number(const char * s, double * out)
+{
+	static const double pow10[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	const char * p;
+	char * end;
+	unsigned long long mant = 0;
+	int ndigits = 0, nsig = 0, exp10 = 0, neg = 0;
+
+	while(*s == ' ' || *s == '\t' || *s == '\r' || *s == '\v' || *s == '\f')
+		s++;
+	p = s;
+	if(*p == '-' || *p == '+')
+		neg = *p++ == '-';
+	for(; *p >= '0' && *p <= '9'; p++, ndigits++){
+		if(nsig > 0 || *p != '0'){
+			mant = mant * 10 + (*p - '0');
+			nsig++;
+		}
+	}
+	if(*p == '.'){
+		for(p++; *p >= '0' && *p <= '9'; p++, ndigits++){
+			if(nsig > 0 || *p != '0'){
+				mant = mant * 10 + (*p - '0');
+				nsig++;
+			}
+			exp10--;
+		}
+	}
+	if(ndigits > 0 && (*p == 'e' || *p == 'E')){
+		const char * q = p + 1;
+		int eneg = 0, e = 0;
+		if(*q == '-' || *q == '+')
+			eneg = *q++ == '-';
+		if(*q >= '0' && *q <= '9'){	// else the 'e' is not part of the number
+			for(; *q >= '0' && *q <= '9'; q++)
+				if(e < 10000)
+					e = e * 10 + (*q - '0');
+			exp10 += eneg ? -e : e;
+			p = q;
+		}
+	}
+	if(ndigits > 0 && nsig <= 19 && mant <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22
+	   && *p != 'x' && *p != 'X'){
+		double x = (double)mant;
+		x = exp10 < 0 ? x / pow10[-exp10] : x * pow10[exp10];
+		*out = neg ? -x : x;
+		return p;
+	}
+	// long mantissas, big exponents, hex, inf, nan
+	pthread_once(&brk_clocale_once, brk_newclocale);
+	if(brk_clocale != (locale_t) 0)
+		*out = strtod_l(s, &end, brk_clocale);
+	else
+		*out = strtod(s, &end);	// no memory for the locale
+	return end == s ? NULL : end;
+}
+
+/* Checking the header of a binary breakpoint file.
+   Returning 0 if it can be read here, 1 for a wrong magic number (not a
+   binary file), 2 for an unknown version or 3 for the other byte order. */
+static int brk_checkheader(const BRKHEADER * header)
+{
+	if(memcmp(header->magic, BRK_MAGIC, sizeof(header->magic)) != 0)
+		return 1;
+	if(header->version != BRK_VERSION)
+		return 2;
+	if(header->endian != BRK_ENDIAN)
+		return 3;
+	return 0;
+}
+
+/* Peeking at the first byte of a file: binary breakpoint files start with
+   the 'B' of BRK_MAGIC, which is no number. */
+static int brk_isbinary(FILE * fp)
+{
+	int c = getc(fp);
+
+	if(c == EOF)
+		return 0;
+	ungetc(c, fp);
+	return c == BRK_MAGIC[0];
+}
+
+/* Returning how many of the points have increasing times, like the check
+   of get_breakpoints: the points up to the first one that goes back. */
+static unsigned long brk_increasing(const BREAKPOINT * points, unsigned long npoints)
+{
+	unsigned long i;
+
+	for(i = 1; i < npoints; i++){
+		if(points[i].time < points[i-1].time){
+			printf("error in breakpoint data at point %lu: time not increasing\n", i + 1);
+			return i;
+		}
+	}
+	return npoints;
+}
+
+/* Reading a binary breakpoint file into a new array, like get_breakpoints
+   does for text; works on pipes too. The count of the header is checked
+   against the size of a regular file before anything is allocated; on a
+   pipe the array grows as the points come in, up to that count. */
+static BREAKPOINT * brk_readbinary(FILE * fp, unsigned long * psize)
+{
+	BRKHEADER header;
+	BREAKPOINT * points, * tmp;
+	unsigned long npoints = 0, size, want, i;
+	size_t got;
+	struct stat st;
+	int error;
+
+	if(fread(&header, sizeof(header), 1, fp) != 1 || (error = brk_checkheader(&header)) == 1){
+		// not a binary file after all: a text file starting with a letter
+		printf("Line 1 has non-numeric data\n");
+		return (BREAKPOINT *) malloc(sizeof(BREAKPOINT));
+	}
+	if(error == 2){
+		printf("Error: binary breakpoint file version %u is not supported\n", (unsigned)header.version);
+		return NULL;
+	}
+	if(error == 3){
+		printf("Error: binary breakpoint file has the wrong byte order\n");
+		return NULL;
+	}
+	if(header.npoints != BRK_TOEND && header.npoints > SIZE_MAX / sizeof(BREAKPOINT)){
+		printf("Error: binary breakpoint file has too many points\n");
+		return NULL;
+	}
+	want = header.npoints == BRK_TOEND ? 0 : (unsigned long) header.npoints;
+	size = NPOINTS;
+	if(header.npoints != BRK_TOEND && fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)){
+		uint64_t start = MAX(header.offset, sizeof(header));
+		uint64_t avail = (uint64_t) st.st_size > start
+			? ((uint64_t) st.st_size - start) / sizeof(BREAKPOINT) : 0;
+		if(want > avail){
+			printf("Error: binary breakpoint file is truncated at point %lu\n", (unsigned long) avail + 1);
+			return NULL;
+		}
+		size = MAX(want, 1);	// all of them fit in the file, so in memory
+	}
+	else if(header.npoints != BRK_TOEND)
+		size = MAX(MIN(want, NPOINTS), 1);
+	for(i = sizeof(header); i < header.offset && getc(fp) != EOF; i++)
+		;	// skip to the first point
+	if((points = (BREAKPOINT *) malloc(sizeof(BREAKPOINT) * size)) == NULL)
+		return NULL;
+	while(header.npoints == BRK_TOEND || npoints < want){
+		got = fread(points + npoints, sizeof(BREAKPOINT), size - npoints, fp);
+		if(got == 0)
+			break;
+		npoints += got;
+		if(npoints < size || npoints == want)
+			continue;
+		// full: double the array, up to the count of the header
+		if(size > SIZE_MAX / 2 / sizeof(BREAKPOINT)){
+			free(points);
+			return NULL;
+		}
+		size = header.npoints == BRK_TOEND ? size * 2 : MIN(size * 2, want);
+		if((tmp = (BREAKPOINT *) realloc(points, sizeof(BREAKPOINT) * size)) == NULL){
+			free(points);
+			return NULL;
+		}
+		points = tmp;
+	}
+	if(header.npoints != BRK_TOEND && npoints != want){
+		printf("Error: binary breakpoint file is truncated at point %lu\n", npoints + 1);
+		free(points);
+		return NULL;
+	}
+	npoints = brk_increasing(points, npoints);
+	if(npoints)
+		*psize = npoints;
+	return points;
+}
+
 /* Getting new breakpoints from a breakpoint text file.
    Input arguments:
    FILE *fp: a fp that has been initialized and points to a text file.
@@ -133,57 +528,190 @@ double val_at_brktime(const BREAKPOINT * points, unsigned long npoints, double t
             *psize is not initiazlied. It will be updated with the 
 			number of breakpoints later in this function.
    Returning: a pointer to an array of BREAKPOINTs.
+   The file is read BRK_CHUNK bytes at a time and split into lines in place;
+   the array doubles when it is full.
 */
 BREAKPOINT * get_breakpoints(FILE * fp, unsigned long * psize)
 {
-	int got;
-	
 	unsigned long npoints = 0, size = NPOINTS;
 	double lasttime = 0.0;
 	BREAKPOINT *points = NULL;	
-	char line[LINELENGTH];
+	char * buf, * line, * nl;
+	size_t cap = BRK_CHUNK, len = 0, got;
+	int eof = 0, stop = 0;
 
 	if(fp == NULL)
 		return NULL;
+	if(brk_isbinary(fp))
+		return brk_readbinary(fp, psize);
 	points = (BREAKPOINT *) malloc(sizeof(BREAKPOINT) * size); // dynamic memory allocation
-	if(points == NULL)
+	buf = (char *) malloc(cap);
+	if(points == NULL || buf == NULL){
+		free(points);
+		free(buf);
 		return NULL;
+	}
 
-	while(fgets(line, LINELENGTH, fp)){		// get a line of string from the breakpoint file		
-		if((got = sscanf(line, "%lf%lf", &points[npoints].time, &points[npoints].value)) < 0) // parse a line of string and get a time and a value.
-			continue;			  /* empty line */
-		if(got == 0){
-			printf("Line %lu has non-numeric data\n", npoints + 1);
-			break;
+	while(!stop && !eof){
+		got = fread(buf + len, 1, cap - 1 - len, fp);	// leave room for a '\0'
+		len += got;
+		eof = got == 0;
+		line = buf;
+		// every complete line, and the last one without a newline at the end of the file
+		while(!stop && ((nl = memchr(line, '\n', buf + len - line)) != NULL || (eof && line < buf + len))){
+			const char * start = line, * p;
+			BREAKPOINT * point = &points[npoints];
+			if(nl == NULL)
+				nl = buf + len;
+			line = nl < buf + len ? nl + 1 : nl;	// the last line may have no newline
+			*nl = '\0';
+			if((p = brk_number(start, &point->time)) == NULL){
+				if(start[strspn(start, " \t\r\v\f")] == '\0')	/* empty line */
+					continue;
+				printf("Line %lu has non-numeric data\n", npoints + 1);
+				stop = 1;
+				break;
+			}
+			if(brk_number(p, &point->value) == NULL){  // only one number is valid
+				printf("Incomplete breakpoint found at point %lu\n", npoints + 1);
+				stop = 1;
+				break;
+			}
+			if(point->time < lasttime){
+				printf("error in breakpoint data at point %lu: time not increasing\n", npoints +1 );
+				stop = 1;
+				break;
+			}
+			lasttime = point->time;
+			if(++npoints == size){ // The current block is full!
+				BREAKPOINT * tmp;
+				size *= 2;  // geometric growth: copying stays linear in the file size
+				tmp = (BREAKPOINT *) realloc(points, sizeof(BREAKPOINT) * size);
+				if(tmp == NULL)	{	/* too bad! */
+					/* have to release the memory, and return NULL to caller */
+					npoints = 0;
+					free(points);
+					points = NULL;
+					stop = 1;
+					break;
+				}
+				points = tmp;  // update the pointer pointing to the array of BREAKPOINTs
+			}
 		}
-		if(got == 1){  // only one number is valid
-			printf("Incomplete breakpoint found at point %lu\n", npoints + 1);
-			break;
-		}		
-		if(points[npoints].time < lasttime){
-			printf("error in breakpoint data at point %lu: time not increasing\n", npoints +1 );
+		if(stop || eof)
 			break;
-		}
-		lasttime = points[npoints].time;
-		if(++npoints == size){ // The current block is full!
-			BREAKPOINT * tmp;
-			size += NPOINTS;  // Update the size of the new block
-			tmp = (BREAKPOINT *) realloc(points, sizeof(BREAKPOINT) * size); // if the size is not large enough.
-			if(tmp == NULL)	{	/* too bad! */
-				/* have to release the memory, and return NULL to caller */
+		// keep the partial line at the front; a line longer than the buffer grows it
+		len = buf + len - line;
+		memmove(buf, line, len);
+		if(len == cap - 1){
+			char * tmp = (char *) realloc(buf, cap * 2);
+			if(tmp == NULL){
 				npoints = 0;
 				free(points);
 				points = NULL;
-				break;		 
+				break;
 			}
-			points = tmp;  // update the pointer pointing to the array of BREAKPOINTs
-		}			
+			buf = tmp;
+			cap *= 2;
+		}
 	}
+	free(buf);
 	if(npoints)							
 		*psize = npoints;  // It is like returning *psize!!!
 	return points;         // returning a pointer to an array of BREAKPOINTs
 }
 
+/* Writing breakpoints to a text file, one "time value" pair per line,
+   in the format read by get_breakpoints.
+   Returning 0 for success or -1 for a write error.
+*/
+int write_breakpoints(FILE * fp, const BREAKPOINT * points, unsigned long npoints)
+{
+	unsigned long i;
+
+	if(fp == NULL)
+		return -1;
+	for(i = 0; i < npoints; i++){
+		if(fprintf(fp, "%f %f\n", points[i].time, points[i].value) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* Writing the header of a binary breakpoint file */
+int write_brkheader(FILE * fp, uint64_t npoints)
+{
+	BRKHEADER header;
+
+	if(fp == NULL)
+		return -1;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BRK_MAGIC, sizeof(header.magic));
+	header.version = BRK_VERSION;
+	header.endian  = BRK_ENDIAN;
+	header.npoints = npoints;
+	header.offset  = sizeof(header);
+	return fwrite(&header, sizeof(header), 1, fp) == 1 ? 0 : -1;
+}
+
+/* Writing breakpoints to a binary breakpoint file */
+int write_breakpoints_binary(FILE * fp, const BREAKPOINT * points, unsigned long npoints)
+{
+	if(write_brkheader(fp, npoints) != 0)
+		return -1;
+	if(npoints > 0 && fwrite(points, sizeof(BREAKPOINT), npoints, fp) != npoints)
+		return -1;
+	return 0;
+}
+
+/* Mapping a binary breakpoint file: the points are used where they are in
+   the file, so loading takes the same time for any size. */
+const BREAKPOINT * map_breakpoints(FILE * fp, unsigned long * psize, BRKMAP * map)
+{
+	struct stat st;
+	const BRKHEADER * header;
+	const BREAKPOINT * points;
+	void * base;
+	size_t length;
+	uint64_t npoints, avail;
+
+	map->base = NULL;
+	map->length = 0;
+	if(fp == NULL || fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)
+	   || st.st_size < (off_t) sizeof(BRKHEADER))
+		return NULL;
+	length = (size_t) st.st_size;
+	base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if(base == MAP_FAILED)
+		return NULL;
+	header = (const BRKHEADER *) base;
+	// the points have to be inside the file and aligned for doubles
+	if(brk_checkheader(header) != 0 || header->offset < sizeof(BRKHEADER)
+	   || header->offset > length || header->offset % sizeof(double) != 0){
+		munmap(base, length);
+		return NULL;
+	}
+	avail = (length - header->offset) / sizeof(BREAKPOINT);
+	npoints = header->npoints == BRK_TOEND ? avail : header->npoints;
+	if(npoints > avail){
+		munmap(base, length);
+		return NULL;
+	}
+	map->base = base;
+	map->length = length;
+	points = (const BREAKPOINT *) ((const char *) base + header->offset);
+	*psize = brk_increasing(points, (unsigned long) npoints);
+	return points;
+}
+
+/* Releasing the mapping of map_breakpoints */
+void unmap_breakpoints(BRKMAP * map)
+{
+	if(map->base != NULL)
+		munmap(map->base, map->length);
+	map->base = NULL;
+	map->length = 0;
+}
 
 /******** breakpoint stream handling **************/
 
@@ -195,28 +723,68 @@ BRKSTREAM * bps_newstream(FILE * fp, unsigned long srate, unsigned long * size)
 	BRKSTREAM * stream;
 	BREAKPOINT * points;
 	unsigned long npoints;   // not initialized
+	BRKMAP map;
 
 	if(srate == 0){
 		printf("Error creating stream - srate cannot be zero\n");
 		return NULL;
 	}
-	stream = (BRKSTREAM *) malloc(sizeof(BRKSTREAM)); // only one BRKSTREAM
-	if(stream == NULL)
-		return NULL;
+	/* a binary file is used in place; get_breakpoints reads the ones that can't be mapped */
+	if(fp != NULL && brk_isbinary(fp)
+	   && (points = (BREAKPOINT *) map_breakpoints(fp, &npoints, &map)) != NULL){
+		if(npoints < 2){
+			printf("breakpoint file is too small - at least two points required\n");
+			unmap_breakpoints(&map);
+			return NULL;
+		}
+		if((stream = bps_newstream_points(points, npoints, srate)) == NULL){
+			unmap_breakpoints(&map);
+			return NULL;
+		}
+		stream->map = map;
+		if(size)
+			*size = npoints;
+		return stream;
+	}
 	/* load breakpoint file and setup stream info  */
 	points = get_breakpoints(fp, &npoints); 
-	if(points == NULL){
-		free(stream);
+	if(points == NULL)
 		return NULL;
-	}
 	if(npoints < 2){ // at least two breakpoints are required
 		printf("breakpoint file is too small - at least two points required\n");
-		free(stream);
+		free(points);
+		return NULL;
+	}
+	stream = bps_newstream_points(points, npoints, srate);
+	if(stream == NULL){
+		free(points);
 		return NULL;
 	}
+	if(size)
+		*size = npoints;   // return *size to the function calling bps_newstream
+
+	return stream; // returning the pointer pointing to a BRKSTREAM struct
+}
+
+/* Used to initialize a new stream from breakpoints already in memory */
+/* the stream takes ownership of points (released by bps_freepoints) */
+/* return a pointer to the initialized BRKSTREAM struct or NULL for error */
+BRKSTREAM * bps_newstream_points(BREAKPOINT * points, unsigned long npoints, unsigned long srate)
+{
+	BRKSTREAM * stream;
+
+	if(points == NULL || npoints < 2 || srate == 0)
+		return NULL;
+	stream = (BRKSTREAM *) malloc(sizeof(BRKSTREAM)); // only one BRKSTREAM
+	if(stream == NULL)
+		return NULL;
 	/* init the stream object */
 	stream->npoints = npoints;
 	stream->points  = points;
+	stream->map.base   = NULL;
+	stream->map.length = 0;
+	stream->index.first = NULL;
+	stream->index.nbuckets = 0;
 	/*  counters */
 	stream->curpos  = 0.0;
 	stream->ileft   = 0;
@@ -228,17 +796,19 @@ BRKSTREAM * bps_newstream(FILE * fp, unsigned long srate, unsigned long * size)
 	stream->width	   = stream->rightpoint.time - stream->leftpoint.time; 
 	stream->height	   = stream->rightpoint.value - stream->leftpoint.value; 	
 	stream->more_points = 1;
-	if(size)
-		*size = npoints;   // return *size to the function calling bps_newstream
 
-	return stream; // returning the pointer pointing to a BRKSTREAM struct
+	return stream;
 }
 
 /* destructor fucntion for breakpoint streams; need to call this before destroying stream itself */
 void bps_freepoints(BRKSTREAM * stream)
 {
 	if(stream && stream->points){
-		free(stream->points);	
+		brk_freeindex(&stream->index);
+		if(stream->map.base != NULL)
+			unmap_breakpoints(&stream->map);
+		else
+			free(stream->points);	
 		stream->points = NULL;
 	}
 }
@@ -302,6 +872,62 @@ double bps_tick(BRKSTREAM * stream)
 	return thisval;
 }
 
+/* Filling a block of n values, the same as calling bps_tick n times.
+   Spans are only checked at their boundaries: inside a span the values are a
+   linear ramp, which is filled by a tight loop the compiler can vectorize.
+   Sample times are computed as an offset from the start of each run rather than
+   accumulated, so they can differ from bps_tick in the last bits.
+*/
+void bps_tick_block(BRKSTREAM * stream, double * out, unsigned long n)
+{
+	unsigned long i, count;
+	double start, slope;
+
+	while(n > 0){
+		/* beyond end of brkdata? */
+		if(stream->more_points == 0){
+			for(i = 0; i < n; i++)
+				out[i] = stream->rightpoint.value;
+			return;
+		}
+		/* number of samples left in this span (bps_tick always emits at least one) */
+		if(stream->curpos > stream->rightpoint.time)
+			count = 1;
+		else
+			count = (unsigned long)((stream->rightpoint.time - stream->curpos) / stream->incr) + 1;
+		count = MIN(count, n);
+
+		if(stream->width == 0.0){
+			for(i = 0; i < count; i++)
+				out[i] = stream->rightpoint.value;
+		}
+		else {
+			/* linear ramp: value at curpos, plus slope per sample */
+			slope = stream->height / stream->width;
+			start = stream->leftpoint.value + slope * (stream->curpos - stream->leftpoint.time);
+			slope *= stream->incr;
+			for(i = 0; i < count; i++)
+				out[i] = start + slope * (double)i;
+		}
+		out += count;
+		n -= count;
+
+		/* move up ready for the next run */
+		stream->curpos += stream->incr * (double)count;
+		if(stream->curpos > stream->rightpoint.time){  /* need to go to next span? */
+			stream->ileft++; stream->iright++;
+			if(stream->iright < stream->npoints) {
+				stream->leftpoint = stream->points[stream->ileft];
+				stream->rightpoint = stream->points[stream->iright];
+				stream->width	= stream->rightpoint.time - stream->leftpoint.time; 
+				stream->height	= stream->rightpoint.value - stream->leftpoint.value;	
+			}
+			else
+				stream->more_points = 0;
+		}
+	}
+}
+
 /* some other utility functions */
 
 /* Rewind stream, so we can use data from beginnign again */
@@ -318,6 +944,47 @@ void bps_rewind(BRKSTREAM * stream)
 	stream->width	= stream->rightpoint.time - stream->leftpoint.time; 
 	stream->height	= stream->rightpoint.value - stream->leftpoint.value;
 	stream->curpos	= 0.0;	
+	stream->more_points = 1;
+}
+
+/* Building the index of a stream for bps_seek */
+int bps_buildindex(BRKSTREAM * stream)
+{
+	if(stream == NULL)
+		return -1;
+	brk_freeindex(&stream->index);
+	return brk_buildindex(&stream->index, stream->points, stream->npoints);
+}
+
+/* Moving the stream to a time: the span of the time, set up the way bps_tick
+   leaves it when it gets there (bps_tick moves one span per tick, so it can
+   lag behind on spans shorter than a tick; bps_seek doesn't).
+*/
+int bps_seek(BRKSTREAM * stream, double time)
+{
+	unsigned long i;
+
+	if(stream == NULL)
+		return -1;
+	if(stream->index.first != NULL)
+		i = brk_findspan_index(&stream->index, stream->points, stream->npoints, time);
+	else
+		i = brk_findspan(stream->points, stream->npoints, time);
+	stream->curpos = time;
+	stream->more_points = i < stream->npoints;
+	if(i == stream->npoints)	// beyond end of brkdata: hold the last value
+		i = stream->npoints - 1;
+	stream->ileft	= i - 1;
+	stream->iright	= i;
+	stream->leftpoint	= stream->points[stream->ileft];
+	stream->rightpoint	= stream->points[stream->iright];
+	stream->width	= stream->rightpoint.time - stream->leftpoint.time; 
+	stream->height	= stream->rightpoint.value - stream->leftpoint.value;
+	if(!stream->more_points){	// bps_tick moves past the last span this way
+		stream->ileft++;
+		stream->iright++;
+	}
+	return 0;
 }
 
 /* Checking if all the breakpoints are within the range */
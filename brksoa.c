@@ -0,0 +1,352 @@
+/*
+brksoa.c -- breakpoints as a structure of arrays
+The scans (the count of a search window, min/max, the range check) have an
+AVX2, an SSE2, a NEON and a scalar kernel; x86 picks AVX2 once, on the first
+brksoa_new, when the CPU has it, the others are chosen when compiling.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <brksoa.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define BRK_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define BRK_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*
+ The scalar kernels; the vector ones finish their last few values with them.
+ */
+
+/* Counting the times t[i] that come before time: !(time <= t[i]) */
+static unsigned long brk_countbefore_scalar(const double * t, unsigned long n, double time)
+{
+    unsigned long i, count = 0;
+
+    for(i = 0; i < n; i++)
+        count += !(time <= t[i]);
+    return count;
+}
+
+/* Widening *pmin ... *pmax (numbers) to the values; NaN values are passed over */
+static void brk_minmax_scalar(const double * v, unsigned long n, double * pmin, double * pmax)
+{
+    double minval = *pmin, maxval = *pmax;
+    unsigned long i;
+
+    for(i = 0; i < n; i++){
+        minval = v[i] < minval ? v[i] : minval;
+        maxval = v[i] > maxval ? v[i] : maxval;
+    }
+    *pmin = minval;
+    *pmax = maxval;
+}
+
+/* Returning 1 if a value is below minval or above maxval */
+static int brk_outside_scalar(const double * v, unsigned long n, double minval, double maxval)
+{
+    unsigned long i;
+
+    for(i = 0; i < n; i++)
+        if(v[i] < minval || v[i] > maxval)
+            return 1;
+    return 0;
+}
+
+#ifdef BRK_X86
+static unsigned long brk_countbefore_sse2(const double * t, unsigned long n, double time)
+{
+    __m128d q = _mm_set1_pd(time);
+    __m128i count = _mm_setzero_si128();
+    unsigned long i = 0;
+    long long lanes[2];
+
+    for(; i + 2 <= n; i += 2)  // a true compare is -1 in its lane
+        count = _mm_sub_epi64(count, _mm_castpd_si128(_mm_cmpnle_pd(q, _mm_loadu_pd(t + i))));
+    _mm_storeu_si128((__m128i *)lanes, count);
+    return (unsigned long)(lanes[0] + lanes[1]) + brk_countbefore_scalar(t + i, n - i, time);
+}
+
+static void brk_minmax_sse2(const double * v, unsigned long n, double * pmin, double * pmax)
+{
+    __m128d lo = _mm_set1_pd(*pmin), hi = _mm_set1_pd(*pmax);
+    unsigned long i = 0;
+    double l[2], h[2];
+
+    for(; i + 2 <= n; i += 2){
+        __m128d x = _mm_load_pd(v + i);
+        lo = _mm_min_pd(x, lo);
+        hi = _mm_max_pd(x, hi);
+    }
+    _mm_storeu_pd(l, lo);
+    _mm_storeu_pd(h, hi);
+    *pmin = l[1] < l[0] ? l[1] : l[0];
+    *pmax = h[1] > h[0] ? h[1] : h[0];
+    brk_minmax_scalar(v + i, n - i, pmin, pmax);
+}
+
+static int brk_outside_sse2(const double * v, unsigned long n, double minval, double maxval)
+{
+    __m128d lo = _mm_set1_pd(minval), hi = _mm_set1_pd(maxval);
+    unsigned long i = 0;
+
+    for(; i + 2 <= n; i += 2){
+        __m128d x = _mm_load_pd(v + i);
+        if(_mm_movemask_pd(_mm_or_pd(_mm_cmplt_pd(x, lo), _mm_cmpgt_pd(x, hi))))
+            return 1;
+    }
+    return brk_outside_scalar(v + i, n - i, minval, maxval);
+}
+
+__attribute__((target("avx2")))
+static unsigned long brk_countbefore_avx2(const double * t, unsigned long n, double time)
+{
+    __m256d q = _mm256_set1_pd(time);
+    __m256i count = _mm256_setzero_si256();
+    unsigned long i = 0;
+    long long lanes[4];
+
+    for(; i + 4 <= n; i += 4)
+        count = _mm256_sub_epi64(count, _mm256_castpd_si256(
+                    _mm256_cmp_pd(q, _mm256_loadu_pd(t + i), _CMP_NLE_UQ)));
+    _mm256_storeu_si256((__m256i *)lanes, count);
+    return (unsigned long)(lanes[0] + lanes[1] + lanes[2] + lanes[3])
+           + brk_countbefore_scalar(t + i, n - i, time);
+}
+
+__attribute__((target("avx2")))
+static void brk_minmax_avx2(const double * v, unsigned long n, double * pmin, double * pmax)
+{
+    __m256d lo = _mm256_set1_pd(*pmin), hi = _mm256_set1_pd(*pmax);
+    __m128d lo2, hi2;
+    unsigned long i = 0;
+
+    for(; i + 4 <= n; i += 4){
+        __m256d x = _mm256_load_pd(v + i);
+        lo = _mm256_min_pd(x, lo);
+        hi = _mm256_max_pd(x, hi);
+    }
+    lo2 = _mm_min_pd(_mm256_castpd256_pd128(lo), _mm256_extractf128_pd(lo, 1));
+    hi2 = _mm_max_pd(_mm256_castpd256_pd128(hi), _mm256_extractf128_pd(hi, 1));
+    lo2 = _mm_min_pd(lo2, _mm_unpackhi_pd(lo2, lo2));
+    hi2 = _mm_max_pd(hi2, _mm_unpackhi_pd(hi2, hi2));
+    *pmin = _mm_cvtsd_f64(lo2);
+    *pmax = _mm_cvtsd_f64(hi2);
+    brk_minmax_scalar(v + i, n - i, pmin, pmax);
+}
+
+__attribute__((target("avx2")))
+static int brk_outside_avx2(const double * v, unsigned long n, double minval, double maxval)
+{
+    __m256d lo = _mm256_set1_pd(minval), hi = _mm256_set1_pd(maxval);
+    unsigned long i = 0;
+
+    for(; i + 4 <= n; i += 4){
+        __m256d x = _mm256_load_pd(v + i);
+        if(_mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(x, lo, _CMP_LT_OQ),
+                                           _mm256_cmp_pd(x, hi, _CMP_GT_OQ))))
+            return 1;
+    }
+    return brk_outside_scalar(v + i, n - i, minval, maxval);
+}
+
+#define BRK_KERNEL(name) name##_sse2
+
+#elif defined(BRK_NEON)
+static unsigned long brk_countbefore_neon(const double * t, unsigned long n, double time)
+{
+    float64x2_t q = vdupq_n_f64(time);
+    uint64x2_t count = vdupq_n_u64(0);
+    unsigned long i = 0;
+
+    for(; i + 2 <= n; i += 2)  // counting time <= t[i], a true compare is all ones
+        count = vsubq_u64(count, vcleq_f64(q, vld1q_f64(t + i)));
+    return i - (unsigned long)vaddvq_u64(count) + brk_countbefore_scalar(t + i, n - i, time);
+}
+
+static void brk_minmax_neon(const double * v, unsigned long n, double * pmin, double * pmax)
+{
+    float64x2_t lo = vdupq_n_f64(*pmin), hi = vdupq_n_f64(*pmax);
+    unsigned long i = 0;
+
+    for(; i + 2 <= n; i += 2){
+        float64x2_t x = vld1q_f64(v + i);
+        lo = vminnmq_f64(x, lo);   // the number if one is NaN, like the x86 kernels
+        hi = vmaxnmq_f64(x, hi);
+    }
+    *pmin = vminnmvq_f64(lo);
+    *pmax = vmaxnmvq_f64(hi);
+    brk_minmax_scalar(v + i, n - i, pmin, pmax);
+}
+
+static int brk_outside_neon(const double * v, unsigned long n, double minval, double maxval)
+{
+    float64x2_t lo = vdupq_n_f64(minval), hi = vdupq_n_f64(maxval);
+    unsigned long i = 0;
+
+    for(; i + 2 <= n; i += 2){
+        float64x2_t x = vld1q_f64(v + i);
+        if(vmaxvq_u32(vreinterpretq_u32_u64(vorrq_u64(vcltq_f64(x, lo), vcgtq_f64(x, hi)))))
+            return 1;
+    }
+    return brk_outside_scalar(v + i, n - i, minval, maxval);
+}
+
+#define BRK_KERNEL(name) name##_neon
+
+#else
+#define BRK_KERNEL(name) name##_scalar
+#endif
+
+/* The kernels in use; brksoa_setup switches x86 to AVX2 */
+static unsigned long (*brk_countbefore)(const double * t, unsigned long n, double time)
+    = BRK_KERNEL(brk_countbefore);
+static void (*brk_minmax)(const double * v, unsigned long n, double * pmin, double * pmax)
+    = BRK_KERNEL(brk_minmax);
+static int (*brk_outside)(const double * v, unsigned long n, double minval, double maxval)
+    = BRK_KERNEL(brk_outside);
+static pthread_once_t brk_once = PTHREAD_ONCE_INIT;
+
+/*
+ Picking the kernels for this CPU, once.
+ */
+static void brksoa_setup(void)
+{
+#ifdef BRK_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        brk_countbefore = brk_countbefore_avx2;
+        brk_minmax = brk_minmax_avx2;
+        brk_outside = brk_outside_avx2;
+    }
+#endif
+}
+
+/*
+ Copying the points; both arrays are in one allocation, the values start
+ at the first aligned address after the times.
+ */
+BRKSOA * brksoa_new(const BREAKPOINT * points, unsigned long npoints)
+{
+    const unsigned long perline = BRKSOA_ALIGN / sizeof(double);
+    unsigned long padded = (npoints + perline - 1) / perline * perline, i;
+    BRKSOA * soa;
+    void * mem;
+
+    if(points == NULL || npoints == 0)
+        return NULL;
+    pthread_once(&brk_once, brksoa_setup);  // every query has a BRKSOA from here
+    if((soa = (BRKSOA *)malloc(sizeof(BRKSOA))) == NULL)
+        return NULL;
+    if(posix_memalign(&mem, BRKSOA_ALIGN, 2 * padded * sizeof(double)) != 0){
+        free(soa);
+        return NULL;
+    }
+    soa->time = (double *)mem;
+    soa->value = soa->time + padded;
+    soa->npoints = npoints;
+    for(i = 0; i < npoints; i++){
+        soa->time[i] = points[i].time;
+        soa->value[i] = points[i].value;
+    }
+    memset(soa->time + npoints, 0, (padded - npoints) * sizeof(double));
+    memset(soa->value + npoints, 0, (padded - npoints) * sizeof(double));
+    return soa;
+}
+
+void brksoa_free(BRKSOA * soa)
+{
+    if(soa == NULL)
+        return;
+    free(soa->time);
+    free(soa);
+}
+
+/*
+ The first point with the largest value: a vector pass for the value,
+ then a search for the first point that has it. Like maxpoint, NaN values
+ are passed over, but a NaN first value is kept: no value compares above
+ it, so the pass leaves it and the result is point 0.
+ */
+BREAKPOINT brksoa_maxpoint(const BRKSOA * soa)
+{
+    double minval = soa->value[0], maxval = soa->value[0];
+    BREAKPOINT point;
+    unsigned long i = 0;
+
+    if(maxval == maxval)
+        brk_minmax(soa->value, soa->npoints, &minval, &maxval);
+    while(i < soa->npoints - 1 && maxval == maxval && soa->value[i] != maxval)
+        i++;
+    point.time = soa->time[i];
+    point.value = soa->value[i];
+    return point;
+}
+
+BREAKPOINT brksoa_minpoint(const BRKSOA * soa)
+{
+    double minval = soa->value[0], maxval = soa->value[0];
+    BREAKPOINT point;
+    unsigned long i = 0;
+
+    if(minval == minval)
+        brk_minmax(soa->value, soa->npoints, &minval, &maxval);
+    while(i < soa->npoints - 1 && minval == minval && soa->value[i] != minval)
+        i++;
+    point.time = soa->time[i];
+    point.value = soa->value[i];
+    return point;
+}
+
+int brksoa_inrange(const BRKSOA * soa, double minval, double maxval)
+{
+    return !brk_outside(soa->value, soa->npoints, minval, maxval);
+}
+
+int brksoa_getminmax(const BRKSOA * soa, double * outmin, double * outmax)
+{
+    if(soa == NULL || soa->npoints < 2)
+        return -1;
+    *outmin = *outmax = soa->value[0];
+    if(*outmin == *outmin)   // a NaN first value is the result, as in brksoa_maxpoint
+        brk_minmax(soa->value, soa->npoints, outmin, outmax);
+    return 0;
+}
+
+/*
+ The times are increasing, so once the span is known to be in lo ... hi,
+ it is lo plus the number of times in the window that come before time.
+ */
+unsigned long brksoa_findspan(const BRKSOA * soa, double time)
+{
+    unsigned long lo = 1, hi = soa->npoints, mid;
+
+    while(hi - lo > BRKSOA_WINDOW){
+        mid = lo + (hi - lo) / 2;
+        if(time <= soa->time[mid])
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    if(hi <= lo)
+        return lo;
+    return lo + brk_countbefore(soa->time + lo, hi - lo, time);
+}
+
+double brksoa_val_at(const BRKSOA * soa, double time)
+{
+    unsigned long i = brksoa_findspan(soa, time);
+    double width;
+
+    /* maintain final value if time beyond end of data */
+    if(i >= soa->npoints)
+        return soa->value[soa->npoints - 1];
+    width = soa->time[i] - soa->time[i-1];
+    if(width == 0.0)     // instant jump
+        return soa->value[i];
+    return soa->value[i-1] + (soa->value[i] - soa->value[i-1]) * ((time - soa->time[i-1]) / width);
+}
@@ -0,0 +1,194 @@
+/*
+engine.c -- realtime-safe auto-panner engine
+The setters only store the new values. ap_process loads them once per call
+and applies them there, so the audio thread never waits for the others.
+Everything ap_process touches is allocated by ap_new, and the constpower
+table is built there.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <engine.h>
+#include <pan.h>
+
+/* The audio thread owns everything but the new* parameters,
+   which the setters write atomically. */
+struct autopanner {
+    LFO      lfo;          // LFO of the current parameters, amplitude 1
+    LFO      fade;         // LFO of the old type or phase during a crossfade
+    unsigned long srate;
+    long     maxframes;    // frames per chunk of the scratch buffers
+    double * pos;          // positions of lfo
+    double * fadepos;      // positions of fade
+    float *  left;         // left channel gains
+    float *  right;        // right channel gains
+    double   width, rate, phase;  // parameters in use
+    int      type;
+    _Atomic double newwidth;      // parameters set by the setters
+    _Atomic double newrate;
+    _Atomic double newphase;
+    _Atomic int    newtype;
+};
+
+static int ap_checkparams(int type, double width, double rate, double phase);
+
+/*
+ Creating an engine with its scratch buffers. The constpower table is built
+ here too (pan_init), so ap_process only reads it.
+ */
+AUTOPANNER * ap_new(unsigned long srate, long maxframes, int type,
+                    double width, double rate, double phase)
+{
+    AUTOPANNER * ap;
+
+    if(maxframes <= 0 || ap_checkparams(type, width, rate, phase) != 0)
+        return NULL;
+    pan_init();
+    if((ap = (AUTOPANNER *)calloc(1, sizeof(AUTOPANNER))) == NULL)
+        return NULL;
+    // the setters must not take a lock the audio thread could wait on
+    if(!atomic_is_lock_free(&ap->newwidth) || !atomic_is_lock_free(&ap->newtype)){
+        free(ap);
+        return NULL;
+    }
+    if(lfo_init(&ap->lfo, type, 1.0, rate, phase, srate) != 0){
+        free(ap);
+        return NULL;
+    }
+    ap->srate = srate;
+    ap->maxframes = maxframes;
+    ap->pos = (double *)malloc(maxframes * sizeof(double));
+    ap->fadepos = (double *)malloc(maxframes * sizeof(double));
+    ap->left = (float *)malloc(maxframes * sizeof(float));
+    ap->right = (float *)malloc(maxframes * sizeof(float));
+    if(ap->pos == NULL || ap->fadepos == NULL || ap->left == NULL || ap->right == NULL){
+        ap_free(ap);
+        return NULL;
+    }
+    ap->width = width;
+    ap->rate = rate;
+    ap->phase = phase;
+    ap->type = type;
+    atomic_init(&ap->newwidth, width);
+    atomic_init(&ap->newrate, rate);
+    atomic_init(&ap->newphase, phase);
+    atomic_init(&ap->newtype, type);
+    return ap;
+}
+
+/*
+ Releasing an engine.
+ */
+void ap_free(AUTOPANNER * ap)
+{
+    if(ap == NULL)
+        return;
+    free(ap->pos);
+    free(ap->fadepos);
+    free(ap->left);
+    free(ap->right);
+    free(ap);
+}
+
+/*
+ The setters; ap_checkparams uses a valid value for the others.
+ */
+int ap_setwidth(AUTOPANNER * ap, double width)
+{
+    if(ap_checkparams(SINE, width, 0.0, 0.0) != 0)
+        return -1;
+    atomic_store_explicit(&ap->newwidth, width, memory_order_relaxed);
+    return 0;
+}
+
+int ap_setrate(AUTOPANNER * ap, double rate)
+{
+    if(ap_checkparams(SINE, 1.0, rate, 0.0) != 0 || rate >= (double)ap->srate)
+        return -1;
+    atomic_store_explicit(&ap->newrate, rate, memory_order_relaxed);
+    return 0;
+}
+
+int ap_setphase(AUTOPANNER * ap, double phase)
+{
+    if(ap_checkparams(SINE, 1.0, 0.0, phase) != 0)
+        return -1;
+    atomic_store_explicit(&ap->newphase, phase, memory_order_relaxed);
+    return 0;
+}
+
+int ap_settype(AUTOPANNER * ap, int type)
+{
+    if(ap_checkparams(type, 1.0, 0.0, 0.0) != 0)
+        return -1;
+    atomic_store_explicit(&ap->newtype, type, memory_order_relaxed);
+    return 0;
+}
+
+/*
+ Panning n frames. A new type or phase starts a crossfade from a copy of
+ the old LFO to the new one over the n frames; a new width is ramped over
+ them the same way.
+ */
+void ap_process(AUTOPANNER * ap, const float * in, float * outl, float * outr, long n)
+{
+    double width = atomic_load_explicit(&ap->newwidth, memory_order_relaxed);
+    double rate = atomic_load_explicit(&ap->newrate, memory_order_relaxed);
+    double phase = atomic_load_explicit(&ap->newphase, memory_order_relaxed);
+    int type = atomic_load_explicit(&ap->newtype, memory_order_relaxed);
+    double width0 = ap->width;
+    int fading = 0;
+    long done, count, i;
+
+    if(n <= 0)
+        return;
+    if(rate != ap->rate){
+        lfo_setfreq(&ap->lfo, rate, ap->srate);
+        ap->rate = rate;
+    }
+    if(type != ap->type || phase != ap->phase){
+        ap->fade = ap->lfo;
+        fading = 1;
+        ap->lfo.phase0 += (phase - ap->phase) / (2.0 * M_PI);
+        ap->lfo.phase0 -= floor(ap->lfo.phase0);
+        if(type != ap->type){
+            ap->lfo.type = type;
+            lfo_seek(&ap->lfo, ap->lfo.frame);  // the random type needs its first values
+        }
+        ap->type = type;
+        ap->phase = phase;
+    }
+    ap->width = width;
+
+    for(done = 0; done < n; done += count){
+        count = n - done < ap->maxframes ? n - done : ap->maxframes;
+        lfo_tick_block(&ap->lfo, ap->pos, count);
+        if(fading){
+            lfo_tick_block(&ap->fade, ap->fadepos, count);
+            for(i = 0; i < count; i++){
+                double t = (double)(done + i + 1) / n;
+                ap->pos[i] = ap->fadepos[i] + (ap->pos[i] - ap->fadepos[i]) * t;
+            }
+        }
+        for(i = 0; i < count; i++)
+            ap->pos[i] *= width0 + (width - width0) * ((double)(done + i + 1) / n);
+        constpower_block(ap->pos, ap->left, ap->right, count);
+        for(i = 0; i < count; i++){
+            float x = in[done + i];
+            outl[done + i] = x * ap->left[i];
+            outr[done + i] = x * ap->right[i];
+        }
+    }
+}
+
+/*
+ Checking the parameters against the ranges of check_params, without messages.
+ */
+static int ap_checkparams(int type, double width, double rate, double phase)
+{
+    if(type < 0 || type >= NLFOTYPES || width < 0.5 || width > 1.0
+       || rate < 0.0 || rate > 10.0 || phase < 0.0 || phase > 2.0 * M_PI)
+        return -1;
+    return 0;
+}
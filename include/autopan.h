@@ -0,0 +1,36 @@
+/*
+autopan.h -- libautopan
+All of the library in one header: rendering files and batches (render.h,
+batch.h), the realtime engine (engine.h), and the parts they are built
+from. Link with -lautopan -lsndfile -lm -lpthread.
+render_job, render_kernel and ap_new call pan_init(); call it yourself before
+using the functions of pan.h directly.
+*/
+
+#ifndef __AUTOPAN_H_INCLUDED
+#define __AUTOPAN_H_INCLUDED
+
+#include <stdio.h>
+#include <sndfile.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <breakpoints.h>
+#include <brksoa.h>
+#include <wavetable.h>
+#include <lfo.h>
+#include <pan.h>
+#include <kernels.h>
+#include <stats.h>
+#include <render.h>
+#include <batch.h>
+#include <tune.h>
+#include <engine.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
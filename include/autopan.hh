@@ -0,0 +1,110 @@
+/*
+autopan.hh -- C++ interface to libautopan
+AutoPanner pans mono audio into stereo with the LFO and the pan kernels of
+the library, from a SndfileHandle into another one, or from buffers in memory.
+Header-only like sndfile.hh; link with -lautopan -lsndfile -lm -lpthread.
+*/
+
+#ifndef __AUTOPAN_HH_INCLUDED
+#define __AUTOPAN_HH_INCLUDED
+
+#include <cmath>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sndfile.hh>
+#include <autopan.h>
+
+class AutoPanner
+{	public :
+		/* type: sine, square, sawtooth, triangle or random; width, rate (Hz) and
+		   phase (radians) as on the command line; samplerate of the audio.
+		   Throws std::invalid_argument for a bad value. */
+		AutoPanner (const std::string & type, double width, double rate, double phase,
+					int samplerate, long blocksize = NFRAMES) ;
+		~AutoPanner (void) ;
+
+		AutoPanner (const AutoPanner &) = delete ;
+		AutoPanner & operator = (const AutoPanner &) = delete ;
+
+		/* Reading the LFO waveform from a table (wt_get, wt_load); NULL for the computed one */
+		void		setTable (const WAVETABLE * table)	{ lfo_settable (&lfo, table) ; }
+
+		/* Seeding the random type (lfo_setseed); the default seed is LFO_SEED */
+		void		setSeed (unsigned long seed)	{ lfo_setseed (&lfo, seed) ; }
+
+		/* Moving the LFO to a frame from t = 0 */
+		void		seek (sf_count_t frame)		{ lfo_seek (&lfo, (unsigned long) frame) ; }
+
+		/* Panning n frames of mono input into interleaved stereo (2 * n floats) */
+		void		process (const float * in, float * out, sf_count_t n) ;
+
+		/* Panning the rest of a mono file into a stereo file with the same sample rate.
+		   Returning the frames rendered; throws std::runtime_error for an error. */
+		sf_count_t	render (SndfileHandle & in, SndfileHandle & out) ;
+
+	private :
+		LFO			lfo ;
+		PANBUFFERS	buf ;
+		int			samplerate ;
+} ;
+
+/*==========================================================================
+** Nothing but implementation below.
+*/
+
+inline
+AutoPanner::AutoPanner (const std::string & type, double width, double rate, double phase,
+						int srate, long blocksize)
+:	samplerate (srate)
+{	// the tables are built once, before any engine runs (thread-safe static)
+	static const bool ready = (pan_init (), wt_get (SINE, 0) != NULL) ;
+	(void) ready ;
+
+	int t = lfo_type (type.c_str ()) ;
+	if (t < 0 || width < 0.5 || width > 1.0 || rate < 0.0 || rate > 10.0
+		|| phase < 0.0 || phase > 2 * M_PI || blocksize < MINFRAMES || blocksize > MAXFRAMES
+		|| lfo_init (&lfo, t, width, rate, phase, srate > 0 ? srate : 0) != 0)
+		throw std::invalid_argument ("AutoPanner: bad parameter") ;
+	if (panbuffers_alloc (&buf, blocksize) != 0)
+		throw std::bad_alloc () ;
+} /* AutoPanner constructor */
+
+inline
+AutoPanner::~AutoPanner (void)
+{	panbuffers_free (&buf) ;
+} /* AutoPanner destructor */
+
+inline void
+AutoPanner::process (const float * in, float * out, sf_count_t n)
+{	RENDERKERNEL kernel = render_kernel (&lfo, KERNEL_FLOAT) ;
+
+	for (sf_count_t done = 0 ; done < n ; done += buf.nframes)
+	{	long count = n - done < buf.nframes ? (long) (n - done) : buf.nframes ;
+		if (kernel != NULL)
+			kernel (&lfo, in + done, out + 2 * done, count) ;
+		else
+			pan_block (&lfo, in + done, out + 2 * done, count, buf.posbuffer, buf.leftgain, buf.rightgain) ;
+		} ;
+} /* AutoPanner::process */
+
+inline sf_count_t
+AutoPanner::render (SndfileHandle & in, SndfileHandle & out)
+{	RENDERKERNEL kernel = render_kernel (&lfo, KERNEL_FLOAT) ;
+	sf_count_t frames = 0, count ;
+
+	if (! in || ! out || in.channels () != 1 || out.channels () != 2 || in.samplerate () != samplerate)
+		throw std::runtime_error ("AutoPanner: need a mono input and a stereo output at the sample rate of the panner") ;
+	while ((count = in.readf (buf.inbuffer, buf.nframes)) > 0)
+	{	if (kernel != NULL)
+			kernel (&lfo, buf.inbuffer, buf.outbuffer, (unsigned long) count) ;
+		else
+			pan_block (&lfo, buf.inbuffer, buf.outbuffer, (long) count, buf.posbuffer, buf.leftgain, buf.rightgain) ;
+		if (out.writef (buf.outbuffer, count) != count)
+			throw std::runtime_error (std::string ("AutoPanner: ") + out.strError ()) ;
+		frames += count ;
+		} ;
+	return frames ;
+} /* AutoPanner::render */
+
+#endif
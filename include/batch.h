@@ -0,0 +1,24 @@
+/*
+batch.h -- batch mode for the auto-panner
+Renders every job of a manifest file on a pool of worker threads.
+*/
+
+#ifndef __BATCH_H_INCLUDED
+#define __BATCH_H_INCLUDED
+
+#include <render.h>
+
+#define MANIFEST_LINELENGTH (4096)  // max. length of a manifest line
+
+/* Rendering all the jobs of a manifest file, one job per line:
+       infile outfile width rate phase type
+   Blank lines and lines starting with # are skipped; file names can't contain spaces.
+   settings: smooth and shape apply to every job.
+   nworkers: number of worker threads; every job renders on one thread.
+   nframes: block size of the renders.
+   Prints a timing summary for each job.
+   Returning 0 if all jobs succeeded, else 1.
+*/
+int run_batch(const char * manifest, const AUTOPANJOB * settings, int nworkers, long nframes);
+
+#endif
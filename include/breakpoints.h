@@ -27,6 +27,8 @@ OTHER DEALINGS IN THE SOFTWARE.
 #define __BREAKPOINTS_H_INCLUDED
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
 
 typedef struct breakpoint {
 		double time;
@@ -46,9 +48,99 @@ int			inrange(const BREAKPOINT * points, double minval, double maxval, unsigned
    betwen two neighboring breakpoints */
 double		val_at_brktime(const BREAKPOINT * points, unsigned long npoints, double time);
 
-/* Getting new breakpoints from a breakpoint text file */
+/* Finding the span containing a specified time with a binary search.
+   Returns the index of the right point of the span, or npoints beyond the end of data */
+unsigned long brk_findspan(const BREAKPOINT * points, unsigned long npoints, double time);
+
+/* Same as val_at_brktime, but caches the span in *pspan between calls (start with 1).
+   O(1) for increasing times; falls back to a binary search on seeks. */
+double		val_at_brktime_from(const BREAKPOINT * points, unsigned long npoints, double time, unsigned long * pspan);
+
+/* Finding the values at m increasing times (for plotting or exporting a curve)
+   in one pass over the points and the times, O(npoints + m). The values are
+   the ones val_at_brktime gives; a time that goes back starts a binary search,
+   so unsorted times work too, only slower. */
+void		val_at_brktimes(const BREAKPOINT * points, unsigned long npoints, const double * times, double * out, unsigned long m);
+
+/* Same as val_at_brktimes for times in any order: sorts the times (with their
+   positions in out) first, O(m log m + npoints).
+   Returning 0, or -1 for out of memory. */
+int			val_at_brktimes_unsorted(const BREAKPOINT * points, unsigned long npoints, const double * times, double * out, unsigned long m);
+
+/* BRKINDEX is a uniform time grid over a set of breakpoints: bucket b covers
+   the times from start + b / scale, and holds the span of its first time.
+   One bucket per point, so for evenly spread times a lookup only checks
+   a few points. */
+typedef struct brk_index {
+	double			start;		// time of the first point
+	double			scale;		// buckets per second; 0 if all points have the same time
+	unsigned long	nbuckets;
+	unsigned long *	first;		// span (as brk_findspan) of the start of each bucket
+} BRKINDEX;
+
+/* Building the index of a set of breakpoints, in one pass over them.
+   Returning 0, or -1 for no points or out of memory. */
+int			brk_buildindex(BRKINDEX * index, const BREAKPOINT * points, unsigned long npoints);
+
+/* Releasing the buckets of an index */
+void		brk_freeindex(BRKINDEX * index);
+
+/* Same as brk_findspan, in O(1) on average: from the bucket of the time,
+   a short scan to the span. The points must be the ones of the index. */
+unsigned long brk_findspan_index(const BRKINDEX * index, const BREAKPOINT * points, unsigned long npoints, double time);
+
+/* Getting new breakpoints from a breakpoint text file.
+   Reads the file in chunks and parses the numbers without sscanf; the values
+   are the same as sscanf("%lf") gives in the C locale, whatever the locale
+   of the program is (the decimal point is always '.').
+   A binary breakpoint file (starting with BRK_MAGIC) is read as it is. */
 BREAKPOINT * get_breakpoints(FILE * fp, unsigned long * psize); 
 
+/* Writing breakpoints to a text file in the format read by get_breakpoints */
+int			write_breakpoints(FILE * fp, const BREAKPOINT * points, unsigned long npoints);
+
+/* Binary breakpoint files: a BRKHEADER, then the points as (time, value)
+   pairs of doubles - the layout of a BREAKPOINT array - in the byte order
+   of the machine that wrote them. No precision is lost, and a file can be
+   mapped and used in place. */
+#define BRK_MAGIC	"BRKPNTS"		// 8 bytes with the '\0'
+#define BRK_VERSION	(1)
+#define BRK_ENDIAN	(0x01020304)	// reads differently in the other byte order
+#define BRK_TOEND	(UINT64_MAX)	// npoints of a file written as a stream: up to the end
+
+typedef struct brk_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	endian;
+	uint64_t	npoints;	// number of points, or BRK_TOEND
+	uint64_t	offset;		// bytes from the start of the file to the first point
+} BRKHEADER;
+
+/* Writing the header of a binary breakpoint file; the points follow it.
+   Use BRK_TOEND if the number of points isn't known yet.
+   Returning 0 for success or -1 for a write error. */
+int			write_brkheader(FILE * fp, uint64_t npoints);
+
+/* Writing breakpoints to a binary breakpoint file (header and points).
+   Returning 0 for success or -1 for a write error. */
+int			write_breakpoints_binary(FILE * fp, const BREAKPOINT * points, unsigned long npoints);
+
+/* BRKMAP is a binary breakpoint file mapped into memory */
+typedef struct brk_map {
+	void *		base;		// start of the mapping, or NULL
+	size_t		length;		// length of the mapping
+} BRKMAP;
+
+/* Mapping a binary breakpoint file read-only, without copying the points.
+   fp must be a regular file; its position doesn't matter. The header is
+   checked, and like get_breakpoints the points end before the first time
+   that isn't increasing. Returning the points (*psize of them, valid
+   until unmap_breakpoints), or NULL if the file can't be mapped. */
+const BREAKPOINT * map_breakpoints(FILE * fp, unsigned long * psize, BRKMAP * map);
+
+/* Releasing the mapping of map_breakpoints */
+void		unmap_breakpoints(BRKMAP * map);
+
 /* BRKSTREAM is a struct used to save and handle a stream of breakpoints. */
 typedef struct breakpoint_stream {
 	BREAKPOINT *	points;
@@ -60,13 +152,20 @@ typedef struct breakpoint_stream {
 	double			height;
 	unsigned long   ileft,iright;
 	int				more_points;
+	BRKMAP			map;	// set if points are mapped from a binary file
+	BRKINDEX		index;	// built by bps_buildindex, for bps_seek
 } BRKSTREAM;
 
 /* Used to initialize a new stream of breakpoints */
 /* srate cannot be 0; size pointer is optional - can be NULL */
+/* a binary breakpoint file is mapped, not read */
 BRKSTREAM *	bps_newstream(FILE * fp,unsigned long srate, unsigned long * size);  
 
-/* Used to free memory used to save breakpoints */
+/* Used to initialize a new stream from breakpoints already in memory */
+/* the stream takes ownership of points; at least two points required */
+BRKSTREAM *	bps_newstream_points(BREAKPOINT * points, unsigned long npoints, unsigned long srate);
+
+/* Used to free memory used to save breakpoints (or unmap them) and the index */
 void		bps_freepoints(BRKSTREAM * stream);
 
 /* Using a BRKSTREAM struct to find a value at a specified time using 
@@ -75,9 +174,22 @@ void		bps_freepoints(BRKSTREAM * stream);
 */
 double		bps_tick(BRKSTREAM * stream);		 /* NB: no error-checking, caller must ensure stream is valid */
 
+/* Filling a block of n values, the same as calling bps_tick n times,
+   but span changes are only handled at span boundaries. */
+void		bps_tick_block(BRKSTREAM * stream, double * out, unsigned long n);	 /* NB: no error-checking */
+
 /* Rewind stream, so we can use data from beginnign again */
 void		bps_rewind(BRKSTREAM * stream); 
 
+/* Building the index of a stream, so bps_seek takes constant time.
+   Returning 0, or -1 for out of memory. */
+int			bps_buildindex(BRKSTREAM * stream);
+
+/* Moving the stream to a time in seconds: the next bps_tick gives the value
+   at that time. Uses the index if there is one, else a binary search.
+   Returning 0, or -1 for a NULL stream. */
+int			bps_seek(BRKSTREAM * stream, double time);
+
 /* Checking if all the breakpoints are within the range */
 int			bps_inrange(BRKSTREAM * stream, double minval, double maxval);
 
@@ -88,8 +200,8 @@ int			bps_inrange(BRKSTREAM * stream, double minval, double maxval);
 int			bps_getminmax(BRKSTREAM * stream, double * outmin, double * outmax);
 
 /* entirely arbitrary...*/
-#define NPOINTS (64)  // Block size: start with a small block for the dynamic array of BREAKPOINTs.
-#define LINELENGTH (80)  // Assume the max. lenghth of a string in the text file is not over this value - 1 .
+#define NPOINTS (64)  // Start with a small block for the dynamic array of BREAKPOINTs; doubled when full.
+#define BRK_CHUNK (1 << 16)  // Bytes read at a time by get_breakpoints; longer lines grow the buffer.
 
 
 #endif
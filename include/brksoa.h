@@ -0,0 +1,55 @@
+/*
+brksoa.h -- breakpoints as a structure of arrays
+BRKSOA keeps the times and the values of a breakpoint set in two separate,
+aligned arrays, so searches and scans over them use whole vector loads
+instead of striding over (time, value) pairs. The functions give the same
+results as their BREAKPOINT counterparts in breakpoints.h, which stay the
+interface for everything that reads, writes and streams breakpoints.
+*/
+
+#ifndef __BRKSOA_H_INCLUDED
+#define __BRKSOA_H_INCLUDED
+
+#include <breakpoints.h>
+
+#define BRKSOA_ALIGN (64)     // bytes; a cache line, and enough for any vector load
+#define BRKSOA_WINDOW (32)    // times left to a vector scan when a search narrows down
+
+typedef struct brk_soa {
+    double *      time;      // times, increasing; BRKSOA_ALIGN aligned
+    double *      value;     // values; BRKSOA_ALIGN aligned
+    unsigned long npoints;
+} BRKSOA;
+
+/* Copying npoints breakpoints (at least one) into a new BRKSOA.
+   Returning NULL for no points or out of memory. */
+BRKSOA * brksoa_new(const BREAKPOINT * points, unsigned long npoints);
+
+/* Releasing a BRKSOA */
+void brksoa_free(BRKSOA * soa);
+
+/* Returning the breakpoint with the largest (smallest) value;
+   the first one if there are several, like maxpoint (minpoint).
+   NaN values are skipped the same way: a NaN value never wins, unless it
+   is the first, which is then returned. */
+BREAKPOINT brksoa_maxpoint(const BRKSOA * soa);
+BREAKPOINT brksoa_minpoint(const BRKSOA * soa);
+
+/* Checking if all the values are within minval ... maxval, like inrange */
+int brksoa_inrange(const BRKSOA * soa, double minval, double maxval);
+
+/* The smallest (*outmin) and largest (*outmax) value, like bps_getminmax.
+   NaN values are skipped (unless the first value is NaN, which is then
+   kept), where bps_getminmax lets a NaN through depending on where it is;
+   without NaN the two agree.
+   Returning 0, or -1 for fewer than 2 points. */
+int brksoa_getminmax(const BRKSOA * soa, double * outmin, double * outmax);
+
+/* Finding the span containing a time, like brk_findspan: a binary search
+   down to BRKSOA_WINDOW times, then a vector count of the times before it */
+unsigned long brksoa_findspan(const BRKSOA * soa, double time);
+
+/* The value at a time by linear interpolation, like val_at_brktime */
+double brksoa_val_at(const BRKSOA * soa, double time);
+
+#endif
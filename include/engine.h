@@ -0,0 +1,41 @@
+/*
+engine.h -- realtime-safe auto-panner engine
+An auto-panner for embedding in a host (a plugin, an audio callback):
+ap_process does no allocation, no I/O and takes no locks, and the
+parameters can be changed from any other thread while it runs.
+*/
+
+#ifndef __ENGINE_H_INCLUDED
+#define __ENGINE_H_INCLUDED
+
+#include <lfo.h>
+
+/* AUTOPANNER is the state of an engine; create it with ap_new */
+typedef struct autopanner AUTOPANNER;
+
+/* Creating an engine for a sample rate; ap_process handles any block size,
+   in chunks of up to maxframes frames. The parameters are checked like
+   check_params does. Calls pan_init. Returning NULL for bad parameters, out
+   of memory, or if this target has no lock-free atomic double. */
+AUTOPANNER * ap_new(unsigned long srate, long maxframes, int type,
+                    double width, double rate, double phase);
+
+/* Releasing an engine */
+void ap_free(AUTOPANNER * ap);
+
+/* Setting a parameter; safe from any thread while ap_process runs.
+   The change is picked up at the start of the next ap_process call:
+   width is ramped over the block, type and phase are crossfaded over the
+   block, and the rate changes without a jump in phase.
+   Returning 0, or -1 for a value out of range (width 0.5 ... 1, rate 0 ... 10 Hz
+   and below the sample rate, phase 0 ... 2 pi, type one of the LFO types). */
+int  ap_setwidth(AUTOPANNER * ap, double width);
+int  ap_setrate(AUTOPANNER * ap, double rate);
+int  ap_setphase(AUTOPANNER * ap, double phase);
+int  ap_settype(AUTOPANNER * ap, int type);
+
+/* Panning n frames of mono input into the left and right outputs.
+   in may be the same buffer as outl or outr. Realtime-safe. */
+void ap_process(AUTOPANNER * ap, const float * in, float * outl, float * outr, long n);
+
+#endif
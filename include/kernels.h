@@ -0,0 +1,29 @@
+/*
+kernels.h -- fused render kernels for the auto-panner
+A render kernel pans a block of mono input into interleaved stereo in one
+loop: LFO position, constant power gains and output sample, the same values
+lfo_tick_block, constpower_block and pan_interleave compute in three passes.
+There is one kernel per waveform and output sample type, each with the
+waveform and the conversion fixed at compile time.
+*/
+
+#ifndef __KERNELS_H_INCLUDED
+#define __KERNELS_H_INCLUDED
+
+#include <lfo.h>
+
+//output sample types of the kernels
+enum{KERNEL_FLOAT,   // float, like pan_interleave
+     KERNEL_PCM16,   // 16-bit, scaled and clipped like libsndfile does
+     NKERNELOUTS};
+
+/* Panning n frames of in[] into 2 * n samples of out[] (float or short,
+   by the output type of the kernel) and moving the LFO up by n frames */
+typedef void (*RENDERKERNEL)(LFO * lfo, const float * in, void * out, unsigned long n);
+
+/* Picking the kernel for the waveform of an LFO (its type, or its table)
+   and an output type; do it once per render. Calls pan_init for the
+   constpower_fast table. Returning NULL for the RANDOM type, which goes through pan_block. */
+RENDERKERNEL render_kernel(const LFO * lfo, int outtype);
+
+#endif
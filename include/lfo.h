@@ -0,0 +1,75 @@
+/*
+lfo.h -- low frequency oscillators for the auto-panner
+The LFO produces the stereo positions (-1.0 left ... 1.0 right) used to pan
+the input file.
+*/
+
+#ifndef __LFO_H_INCLUDED
+#define __LFO_H_INCLUDED
+
+#include <wavetable.h>
+
+//indices for LFO (panning) types
+enum{SINE,SQUARE,SAWTOOTH,TRIANGLE,RANDOM,NLFOTYPES};
+
+//command line names for LFO types, indexed by type
+extern const char * lfo_typenames[NLFOTYPES];
+
+#define LFO_STEP (1000)  // frames between two random values of the RANDOM type
+#define LFO_SEED (0)     // seed of the RANDOM values until lfo_setseed
+
+/* LFO is a phase-accumulator oscillator.
+   The phase is kept in cycles (0.0 - 1.0) and re-anchored to the frame count
+   at the start of every block, so it does not drift however long the file is. */
+typedef struct lfo {
+    int     type;           // LFO type: SINE, SQUARE, ...
+    double  amp;            // amplitude (width)
+    double  phase0;         // phase at frame 0 in cycles
+    double  incr;           // phase increment per frame in cycles
+    double  coswinc;        // SINE: rotation per frame
+    double  sinwinc;
+    unsigned long frame;    // current frame from t = 0
+    unsigned long step;     // RANDOM: frames between two random values
+    unsigned long segment;  // RANDOM: index of the current segment
+    unsigned long seed;     // RANDOM: seed of the values
+    double  randleft;       // RANDOM: values at both ends of the current segment
+    double  randright;
+    const WAVETABLE * table; // if not NULL, the waveform is read from this table
+} LFO;
+
+/* Returning the LFO type for a command line name, or -1 if unknown */
+int lfo_type(const char * name);
+
+/* Initializing an LFO.
+   amp: amplitude (width), freq: rate in Hz, phase: phase in radians.
+   srate is the rate lfo_tick_block is called at: the audio rate, or a
+   lower control rate if the caller interpolates between the values;
+   freq must be below it.
+   Returning 0 for success or -1 for bad arguments.
+*/
+int lfo_init(LFO * lfo, int type, double amp, double freq, double phase, unsigned long srate);
+
+/* Allocating and initializing an LFO; release with free(). NULL for error. */
+LFO * lfo_new(int type, double amp, double freq, double phase, unsigned long srate);
+
+/* Changing the rate to freq Hz (below srate) without a jump in phase at the
+   current frame. Returning 0 for success or -1 for bad arguments. */
+int lfo_setfreq(LFO * lfo, double freq, unsigned long srate);
+
+/* Reading the waveform from a wavetable instead of computing it
+   (e.g. a band-limited table from wt_get, or a custom shape from wt_load).
+   The table must outlive the LFO; NULL goes back to the computed waveform.
+*/
+void lfo_settable(LFO * lfo, const WAVETABLE * table);
+
+/* Seeding the RANDOM values. Value k (at frame k * step) depends only on
+   the seed and k, so the same seed gives the same pan from any start frame. */
+void lfo_setseed(LFO * lfo, unsigned long seed);
+
+/* Moving the LFO to a frame from t = 0 */
+void lfo_seek(LFO * lfo, unsigned long frame);
+
+/* Filling a block of n pan positions and moving the LFO up by n frames */
+void lfo_tick_block(LFO * lfo, double * out, unsigned long n);
+
+#endif
@@ -0,0 +1,40 @@
+/*
+mmapwav.h -- memory-mapped WAV files for the auto-panner
+Maps the data chunk of a plain PCM 16-bit or 32-bit float WAV file, so the
+samples can be read and written in place. libsndfile still writes the
+header of the output file.
+*/
+
+#ifndef __MMAPWAV_H_INCLUDED
+#define __MMAPWAV_H_INCLUDED
+
+#include <sndfile.h>
+
+/* WAVMAP is a WAV file mapped into memory */
+typedef struct wavmap {
+    void *     base;        // start of the mapping
+    size_t     length;      // length of the mapping in bytes
+    void *     data;        // first sample of the data chunk (chunks are only 2-byte aligned)
+    sf_count_t frames;      // frames in the data chunk
+    int        channels;
+    int        samplerate;
+    int        subtype;     // SF_FORMAT_PCM_16 or SF_FORMAT_FLOAT
+} WAVMAP;
+
+/* Mapping a WAV file read-only.
+   Returning 0 for success, or -1 if the file is not a plain little-endian
+   PCM 16-bit or float WAV file (or mmap is not available). */
+int  wav_map_input(const char * filename, WAVMAP * map);
+
+/* Creating a WAV file for sfinfo (major format WAV, subtype PCM_16 or FLOAT)
+   with room for frames frames, and mapping it read-write.
+   libsndfile writes the header; the data chunk is then allocated on disk
+   and mapped. Returning 0 for success or -1 for an error (also when the
+   disk has no room: the caller can fall back to libsndfile). */
+int  wav_map_output(const char * filename, SF_INFO * sfinfo, sf_count_t frames, WAVMAP * map);
+
+/* Unmapping a file; an output file is flushed to disk.
+   Returning 0, or -1 if the flush or the unmapping failed. */
+int  wav_unmap(WAVMAP * map);
+
+#endif
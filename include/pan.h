@@ -0,0 +1,85 @@
+/*
+pan.h -- constant power panning for the auto-panner
+Turns stereo positions (-1.0 left ... 1.0 right) into left/right gains.
+*/
+
+#ifndef __PAN_H_INCLUDED
+#define __PAN_H_INCLUDED
+
+typedef struct panamps{
+    double left;          // amp to the left channel
+    double right;         // amp to the right channel
+} PANAMPS;                // panning amplitudes
+
+#define CP_SIZE (1024)    // intervals in the constpower_fast table
+
+/* The constpower_fast table: cos((x + 1) * pi/4) for x = -1.0 ... 1.0, plus a
+   guard point. Built by pan_init; the table functions below don't check. */
+extern double cp_table[CP_SIZE + 2];
+
+/* Constant power panning (Richard Dobson): left = cos, right = sin of (position + 1) * pi/4 */
+PANAMPS constpower(double position);
+
+/* Same as constpower, but read from a table with linear interpolation.
+   position is clamped to -1.0 ... 1.0.
+   Maximum error against constpower: 2.95e-7, measured over 2e7 positions
+   (the bound for linear interpolation is (pi/4 * 2/CP_SIZE)^2 / 8 = 2.95e-7).
+*/
+PANAMPS constpower_fast(double position);
+
+/* constpower_fast for a block of n positions, writing the gains to left[] and right[] */
+void constpower_block(const double * position, float * left, float * right, unsigned long n);
+
+/* constpower_block with the gains as Q15 integers (gain * 32768, rounded, at most 32767) */
+void constpower_block_q15(const double * position, short * left, short * right, unsigned long n);
+
+/* The same with Q31 gains, for 24 and 32-bit samples */
+void constpower_block_q31(const double * position, int * left, int * right, unsigned long n);
+
+/* Reading the left gain of a position from cp_table; the right gain is the
+   left gain of -position. Inline for the loops that pan sample by sample. */
+static inline double cp_gain(double position)
+{
+    double x, frac;
+    int i;
+
+    if(position < -1.0)
+        position = -1.0;
+    else if(position > 1.0)
+        position = 1.0;
+    x = (position + 1.0) * (0.5 * CP_SIZE);
+    i = (int)x;
+    frac = x - i;
+    return cp_table[i] + (cp_table[i+1] - cp_table[i]) * frac;
+}
+
+/* Multiplying a mono block by the left/right gains and interleaving the
+   result into stereo: out[2*i] = in[i] * left[i], out[2*i+1] = in[i] * right[i].
+   Points to the fastest kernel for this CPU once pan_init has been called
+   (the scalar kernel before that).
+*/
+extern void (*pan_interleave)(const float * in, const float * left, const float * right,
+                              float * out, unsigned long n);
+
+/* pan_interleave for 16-bit samples and Q15 gains:
+   out[2*i] = in[i] * left[i] / 32768, rounded and saturated, and the same for right.
+   Points to the AVX2, SSSE3, NEON or scalar kernel once pan_init has been called;
+   they all give the same result.
+*/
+extern void (*pan_interleave_s16)(const short * in, const short * left, const short * right,
+                                  short * out, unsigned long n);
+
+/* pan_interleave_s16 for 32-bit samples (24-bit samples sit in the top bits)
+   and Q31 gains: out[2*i] = in[i] * left[i] / 2^31, rounded */
+void pan_interleave_s32(const int * in, const int * left, const int * right,
+                        int * out, unsigned long n);
+
+/* Picking the pan_interleave kernels for this CPU (AVX-512, AVX2, SSE2, NEON or scalar)
+   and building the constpower_fast table. Safe from any thread; only the first
+   call does the work. render_job, render_kernel and ap_new call it. */
+void pan_init(void);
+
+/* Returning the name of the kernel pan_interleave points to */
+const char * pan_kernelname(void);
+
+#endif
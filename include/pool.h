@@ -0,0 +1,19 @@
+/*
+pool.h -- a fixed-size work-stealing thread pool
+Runs a fixed set of tasks on a fixed number of worker threads. Every worker
+starts with its own share of the tasks and steals from the others when it
+runs out, so long and short tasks even out.
+*/
+
+#ifndef __POOL_H_INCLUDED
+#define __POOL_H_INCLUDED
+
+/* A task: task is its index (0 ... ntasks - 1), worker is the index of the
+   worker thread running it (0 ... nworkers - 1), e.g. to pick its buffers */
+typedef void (*POOLTASK)(int task, int worker, void * context);
+
+/* Running tasks 0 ... ntasks - 1 on nworkers threads and waiting for all of them.
+   Returning 0 for success or -1 if the threads could not be started. */
+int pool_run(int nworkers, int ntasks, POOLTASK run, void * context);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+render.h -- rendering for the auto-panner
+Pans a mono sound file into a stereo sound file with an LFO.
+*/
+
+#ifndef __RENDER_H_INCLUDED
+#define __RENDER_H_INCLUDED
+
+#include <sndfile.h>
+#include <lfo.h>
+#include <wavetable.h>
+#include <stats.h>
+
+#define NFRAMES (1024)  // default block size: number of frames per block
+#define MINFRAMES (16)  // smallest block size
+#define MAXFRAMES (1 << 20)  // largest block size
+#define THREAD_FRAMES (1 << 16)  // frames per thread and round with several threads (at least one block)
+#define MAXTHREADS (64)
+#define PIPE_SLOTS (16)  // blocks in each ring of the pipelined render
+
+/* AUTOPANJOB holds the settings of one render */
+typedef struct autopan_job {
+    const char * infilename;   // input file name, or "-" for stdin
+    const char * outfilename;  // output file name, or "-" for stdout
+    double  width;             // width of panning
+    double  rate;              // rate of panning in Hz
+    double  phase;             // phase of panning in radians
+    int     type;              // panning type
+    int     smooth;            // use band-limited waveforms
+    const WAVETABLE * shape;   // custom LFO shape, or NULL
+    unsigned long seed;        // seed of the random type (lfo_setseed)
+    const char * exportname;   // breakpoint file for debugging, or NULL
+    int     nthreads;          // threads for rendering
+    int     pipeline;          // read, pan and write on three threads
+    int     mmap;              // render WAV files through memory maps
+    int     intpcm;            // pan 16/24/32-bit PCM as integers (one thread, no pipeline)
+    RENDERSTATS * stats;       // times of the stages, or NULL
+    int     rawformat;         // subtype of a headerless mono input (raw_subtype), or 0
+    int     rawrate;           // sample rate of a headerless input
+    int     outfd;             // file descriptor written when outfilename is "-"
+    sf_count_t frames;         // set by render_job: frames rendered
+    int     samplerate;        // set by render_job: sample rate of the input
+} AUTOPANJOB;
+
+/* PANBUFFERS holds the block buffers of a render; they can be reused for many renders */
+typedef struct panbuffers {
+    long     nframes;    // frames per block
+    float *  inbuffer;   // mono input
+    float *  outbuffer;  // stereo output
+    double * posbuffer;  // stereo positions
+    float *  leftgain;   // left channel gains
+    float *  rightgain;  // right channel gains
+    int *    inpcm;      // mono integer input (shorts for 16-bit)
+    int *    outpcm;     // stereo integer output (shorts for 16-bit)
+    int *    leftfix;    // left channel gains in Q31 (Q15 shorts for 16-bit)
+    int *    rightfix;   // right channel gains in Q31 (Q15 shorts for 16-bit)
+} PANBUFFERS;
+
+/* Allocating buffers for blocks of nframes frames; returning 0 for success or -1 */
+int  panbuffers_alloc(PANBUFFERS * buf, long nframes);
+
+/* Releasing the buffers of panbuffers_alloc */
+void panbuffers_free(PANBUFFERS * buf);
+
+/* Checking the width, rate and phase and looking up the panning type.
+   Prints a message and returns 1 for an invalid value, else sets *type and returns 0. */
+int  check_params(double width, double rate, double phase, const char * typestr, int * type);
+
+/* Determine the major format with the file extension (wav, aif, aiff, w64); -1 if unknown */
+int  sf_extension(const char * filename);
+
+/* Looking up the sample format of a headerless input (s16, s24, s32 or f32, little-endian).
+   Returning the libsndfile subtype and endianness, or 0 for an unknown name. */
+int  raw_subtype(const char * name);
+
+/* Panning one block of n frames with the LFO into interleaved stereo.
+   pos, left and right are scratch buffers of at least n values. */
+void pan_block(LFO * lfo, const float * in, float * out, long n,
+               double * pos, float * left, float * right);
+
+/* Rendering one job with the given buffers.
+   "-" reads stdin or writes stdout (as AU, or raw for a raw input) in bounded memory;
+   the caller must set outfd and keep its own messages off stdout.
+   Prints a message and returns 1 for an error, else returns 0. */
+int  render_job(AUTOPANJOB * job, PANBUFFERS * buf);
+
+/* Rendering an input file with nthreads threads into outfile, in blocks of nframes frames.
+   Returning the frames rendered, or -1 for an error. */
+sf_count_t render_threads(const char * infilename, SNDFILE * outfile, const LFO * lfo,
+                          int nthreads, long nframes);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ringbuf.h -- single-producer/single-consumer lock-free ring buffer
+A fixed number of fixed-size slots passed from one thread to another.
+The producer fills a slot and commits it; the consumer reads a slot and
+releases it. Neither side takes a lock while slots are ready; a side that
+has to wait spins for a moment, then sleeps until the other side wakes it.
+*/
+
+#ifndef __RINGBUF_H_INCLUDED
+#define __RINGBUF_H_INCLUDED
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define RB_SPIN (1000)   // polls of a waiting side before it sleeps
+
+/* head and tail are on cache lines of their own, so the producer and the
+   consumer don't keep taking the same line from each other */
+typedef struct ringbuf {
+    char *  slots;                  // nslots * slotsize bytes
+    size_t  slotsize;               // bytes per slot, a multiple of 64
+    unsigned long nslots;           // number of slots, a power of two
+    _Alignas(64) _Atomic unsigned long head;  // slots committed by the producer
+    _Alignas(64) _Atomic unsigned long tail;  // slots released by the consumer
+    _Alignas(64) _Atomic int sleepers;        // sides asleep in a wait, or going to sleep
+    pthread_mutex_t lock;           // for the sleeping side only
+    pthread_cond_t  wake;
+} RINGBUF;
+
+/* Initializing a ring of nslots (a power of two) slots of at least slotsize bytes.
+   Returning 0 for success or -1 for error. */
+int    rb_init(RINGBUF * rb, unsigned long nslots, size_t slotsize);
+
+/* Releasing the memory of a ring */
+void   rb_free(RINGBUF * rb);
+
+/* Producer: the next free slot, or NULL if the ring is full */
+void * rb_write_slot(RINGBUF * rb);
+
+/* Producer: handing the slot from rb_write_slot to the consumer */
+void   rb_write_commit(RINGBUF * rb);
+
+/* Consumer: the next committed slot, or NULL if the ring is empty */
+void * rb_read_slot(RINGBUF * rb);
+
+/* Consumer: giving the slot from rb_read_slot back to the producer */
+void   rb_read_release(RINGBUF * rb);
+
+/* Waiting versions of rb_write_slot and rb_read_slot: they poll RB_SPIN
+   times, then sleep until the other side commits or releases a slot */
+void * rb_write_wait(RINGBUF * rb);
+void * rb_read_wait(RINGBUF * rb);
+
+#endif
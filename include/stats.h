@@ -0,0 +1,43 @@
+/*
+stats.h -- per-stage timing for the auto-panner
+Charges the wall and CPU time between two marks to a stage of the render,
+and reports them with the frames rendered and the realtime factor.
+*/
+
+#ifndef __STATS_H_INCLUDED
+#define __STATS_H_INCLUDED
+
+#include <stdio.h>
+
+/* stages of a render */
+enum{STAGE_SETUP,    // arguments, shape file, opening the files, LFO setup
+     STAGE_DECODE,   // reading and converting the input samples
+     STAGE_LFO,      // stereo positions from the LFO
+     STAGE_PAN,      // constant power gains and interleaving
+     STAGE_ENCODE,   // converting and writing the output samples
+     STAGE_EXPORT,   // writing the --export breakpoint file
+     STAGE_RENDER,   // threaded or pipelined render: all of the above at once
+     STAGE_FINISH,   // closing the files
+     NSTAGES};
+
+extern const char * stats_stagenames[NSTAGES];
+
+/* RENDERSTATS holds the times of the stages of one render */
+typedef struct render_stats {
+    double wall[NSTAGES];   // wall time in seconds
+    double cpu[NSTAGES];    // CPU time of the process (all threads) in seconds
+    double lastwall;        // time of the last mark
+    double lastcpu;
+} RENDERSTATS;
+
+/* Clearing the stats and starting the clock */
+void stats_start(RENDERSTATS * stats);
+
+/* Charging the time since the last mark to stage. Does nothing if stats is NULL. */
+void stats_mark(RENDERSTATS * stats, int stage);
+
+/* Printing the times of the stages, the frames and the realtime factor,
+   as a table or (json != 0) as a JSON object */
+void stats_print(FILE * fp, const RENDERSTATS * stats, long long frames, int samplerate, int json);
+
+#endif
@@ -0,0 +1,26 @@
+/*
+tune.h -- block size auto-tuning for the auto-panner
+Times a few block sizes on this machine, reading, panning and writing a
+scratch file, and remembers the fastest one.
+*/
+
+#ifndef __TUNE_H_INCLUDED
+#define __TUNE_H_INCLUDED
+
+#define TUNE_FRAMES (1 << 20)   // frames of the scratch file
+#define TUNE_RUNS (3)           // runs per block size; the fastest counts
+#define TUNE_FILE ".autopan-blocksize"  // cache file in the home directory
+#define TUNE_VERSION (2)        // of the timed render; other cached choices are timed again
+
+/* Size in bytes of the level 1 data cache (level 1) or of the level 2 cache (level 2),
+   from sysconf, sysfs or sysctl. Returning 0 if unknown. */
+long cache_size(int level);
+
+/* Finding the fastest block size on this machine.
+   The choice is read from ~/.autopan-blocksize if it was tuned for the same
+   cache sizes and TUNE_VERSION, else the block sizes between the ones filling L1 and L2 are
+   timed and the winner is saved there.
+   Returning the block size, or NFRAMES if the timing could not be done. */
+long tune_blocksize(void);
+
+#endif
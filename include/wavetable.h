@@ -0,0 +1,44 @@
+/*
+wavetable.h -- wavetables for the auto-panner LFO
+A wavetable holds one cycle of a waveform (-1.0 ... 1.0) and is read with
+linear interpolation, which is much cheaper than calling libm per sample.
+*/
+
+#ifndef __WAVETABLE_H_INCLUDED
+#define __WAVETABLE_H_INCLUDED
+
+#include <stdio.h>
+
+#define WT_SIZE (2048)       // points per cycle; must be a power of two
+#define WT_HARMONICS (16)    // highest harmonic of a band-limited table
+
+typedef struct wavetable {
+    float table[WT_SIZE + 1];  // one cycle plus a guard point (= table[0])
+} WAVETABLE;
+
+/* Returning the table for an LFO type (SINE, SQUARE, SAWTOOTH or TRIANGLE).
+   bandlimited: if non-zero, the table only has harmonics up to WT_HARMONICS,
+   so the edges of square and sawtooth are rounded off and don't click.
+   The tables are built once, by the first call on any thread.
+   Returning NULL for any other type.
+*/
+const WAVETABLE * wt_get(int type, int bandlimited);
+
+/* Loading a custom LFO shape from a breakpoint text file.
+   The times of the file span one cycle; the values must be in -1.0 ... 1.0.
+   Returning a new table (free with free()) or NULL for error.
+*/
+WAVETABLE * wt_load(FILE * fp);
+
+/* Reading a table at a phase in cycles (0.0 <= phase < 1.0; an LFO keeps
+   its phase there because lfo_init wants its rate below the sample rate) */
+static inline double wt_lookup(const WAVETABLE * wt, double phase)
+{
+    double x = phase * WT_SIZE;
+    int i = (int)x;
+    double frac = x - i;
+
+    return wt->table[i] + (wt->table[i+1] - wt->table[i]) * frac;
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*
+kernels.c -- fused render kernels for the auto-panner
+kernel_body is written once for every waveform and output type; each kernel
+calls it with constant arguments, so after inlining the switches on them are
+gone and every kernel is a loop without branches on the waveform.
+*/
+
+#include <math.h>
+#include <lfo.h>
+#include <pan.h>
+#include <wavetable.h>
+#include <kernels.h>
+
+#if defined(__GNUC__)
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE static inline
+#endif
+
+#define KERNEL_TABLE (NLFOTYPES)   // waveform index of an LFO reading a wavetable
+
+/*
+ Storing frame i of the output as float or as clipped 16-bit samples.
+ */
+KERNEL_INLINE void kernel_store(void * out, unsigned long i, float left, float right,
+                                const int outtype)
+{
+    if(outtype == KERNEL_PCM16){
+        short * samples = (short *)out;
+        long l = lrintf(left * 32767.0f), r = lrintf(right * 32767.0f);
+        samples[2*i]   = (short)(l > 32767 ? 32767 : l < -32768 ? -32768 : l);
+        samples[2*i+1] = (short)(r > 32767 ? 32767 : r < -32768 ? -32768 : r);
+    }
+    else{
+        float * samples = (float *)out;
+        samples[2*i]   = left;
+        samples[2*i+1] = right;
+    }
+}
+
+/*
+ The loop of lfo_tick_block, constpower_block and pan_interleave in one,
+ for a waveform (an LFO type or KERNEL_TABLE) and an output type.
+ */
+KERNEL_INLINE void kernel_body(LFO * lfo, const float * in, void * out, unsigned long n,
+                               const int wave, const int outtype)
+{
+    const double amp = lfo->amp;
+    const double incr = lfo->incr;
+    const double coswinc = lfo->coswinc, sinwinc = lfo->sinwinc;
+    const WAVETABLE * wt = lfo->table;
+    double p = lfo->phase0 + (double)lfo->frame * incr;  // phase in cycles
+    double s = 0.0, c = 0.0, t, pos;
+    unsigned long i;
+
+    p -= floor(p);
+    if(wave == SINE){
+        s = sin(2.0 * M_PI * p);
+        c = cos(2.0 * M_PI * p);
+    }
+    for(i = 0; i < n; i++){
+        switch(wave){
+        case SINE:
+            pos = amp * s;
+            t = s * coswinc + c * sinwinc;
+            c = c * coswinc - s * sinwinc;
+            s = t;
+            break;
+        case SQUARE:
+            pos = p < 0.5 ? amp : -amp;
+            break;
+        case SAWTOOTH:
+            pos = amp * (2.0 * p - 1.0);
+            break;
+        case TRIANGLE:
+            if(p < 0.25)
+                pos = amp * (4.0 * p);
+            else if(p < 0.75)
+                pos = amp * (2.0 - 4.0 * p);
+            else
+                pos = amp * (4.0 * p - 4.0);
+            break;
+        default:  // KERNEL_TABLE
+            pos = amp * wt_lookup(wt, p);
+            break;
+        }
+        if(wave != SINE){
+            p += incr;
+            if(p >= 1.0)
+                p -= 1.0;
+        }
+        kernel_store(out, i, in[i] * (float)cp_gain(pos), in[i] * (float)cp_gain(-pos), outtype);
+    }
+    lfo->frame += n;
+}
+
+#define KERNEL(name, wave, outtype) \
+static void name(LFO * lfo, const float * in, void * out, unsigned long n) \
+{ \
+    kernel_body(lfo, in, out, n, wave, outtype); \
+}
+
+KERNEL(kernel_sine_float, SINE, KERNEL_FLOAT)
+KERNEL(kernel_square_float, SQUARE, KERNEL_FLOAT)
+KERNEL(kernel_sawtooth_float, SAWTOOTH, KERNEL_FLOAT)
+KERNEL(kernel_triangle_float, TRIANGLE, KERNEL_FLOAT)
+KERNEL(kernel_table_float, KERNEL_TABLE, KERNEL_FLOAT)
+KERNEL(kernel_sine_pcm16, SINE, KERNEL_PCM16)
+KERNEL(kernel_square_pcm16, SQUARE, KERNEL_PCM16)
+KERNEL(kernel_sawtooth_pcm16, SAWTOOTH, KERNEL_PCM16)
+KERNEL(kernel_triangle_pcm16, TRIANGLE, KERNEL_PCM16)
+KERNEL(kernel_table_pcm16, KERNEL_TABLE, KERNEL_PCM16)
+
+// indexed by [output type][waveform]; RANDOM has no kernel
+static const RENDERKERNEL kernels[NKERNELOUTS][KERNEL_TABLE + 1] = {
+    {kernel_sine_float, kernel_square_float, kernel_sawtooth_float,
+     kernel_triangle_float, NULL, kernel_table_float},
+    {kernel_sine_pcm16, kernel_square_pcm16, kernel_sawtooth_pcm16,
+     kernel_triangle_pcm16, NULL, kernel_table_pcm16}
+};
+
+RENDERKERNEL render_kernel(const LFO * lfo, int outtype)
+{
+    if(outtype < 0 || outtype >= NKERNELOUTS || lfo->type < 0 || lfo->type >= NLFOTYPES)
+        return NULL;
+    pan_init();  // the constpower_fast table, once
+    if(lfo->table != NULL)
+        return kernels[outtype][KERNEL_TABLE];
+    return kernels[outtype][lfo->type];
+}
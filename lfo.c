@@ -0,0 +1,226 @@
+/*
+lfo.c -- low frequency oscillators for the auto-panner
+Generates the pan positions for the sine, square, sawtooth, triangle and
+random LFO types sample by sample, straight into the render loop.
+Each type has its own loop over a block, so the cost per sample is a few
+adds and multiplies; libm is only called once per block. The random values
+are a function of the seed and their index, so any frame can be computed
+without the ones before it.
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <lfo.h>
+
+//command line names for LFO types
+const char * lfo_typenames[NLFOTYPES] = {"sine","square","sawtooth","triangle","random"};
+
+static double lfo_random(const LFO * lfo, unsigned long k); // random value k in -amp ... amp
+
+/*
+ Returning the LFO type for a command line name, or -1 if unknown.
+ */
+int lfo_type(const char * name)
+{
+    for(int i = 0; i < NLFOTYPES; i++){
+        if(strcmp(name, lfo_typenames[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ Initializing an LFO; the phase in radians is turned into cycles.
+ */
+int lfo_init(LFO * lfo, int type, double amp, double freq, double phase, unsigned long srate)
+{
+    // below srate the phase moves less than a cycle per frame, so one
+    // subtraction keeps it in 0.0 ... 1.0 for the wavetables
+    if(lfo == NULL || type < 0 || type >= NLFOTYPES || srate == 0
+       || !(freq >= 0.0 && freq < (double)srate))
+        return -1;
+    lfo->type = type;
+    lfo->amp = amp;
+    lfo->phase0 = phase / (2.0 * M_PI);
+    lfo->phase0 -= floor(lfo->phase0);
+    lfo->incr = freq / (double)srate;
+    lfo->coswinc = cos(2.0 * M_PI * lfo->incr);
+    lfo->sinwinc = sin(2.0 * M_PI * lfo->incr);
+    lfo->step = LFO_STEP;
+    lfo->seed = LFO_SEED;
+    lfo->table = NULL;
+    lfo_seek(lfo, 0);
+    return 0;
+}
+
+/*
+ Allocating and initializing an LFO.
+ */
+LFO * lfo_new(int type, double amp, double freq, double phase, unsigned long srate)
+{
+    LFO * lfo = (LFO *)malloc(sizeof(LFO));
+
+    if(lfo != NULL && lfo_init(lfo, type, amp, freq, phase, srate) != 0){
+        free(lfo);
+        lfo = NULL;
+    }
+    return lfo;
+}
+
+/*
+ Changing the rate at the current frame: phase0 is moved so that the
+ phase at the current frame stays where it was.
+ */
+int lfo_setfreq(LFO * lfo, double freq, unsigned long srate)
+{
+    double p;
+
+    if(srate == 0 || !(freq >= 0.0 && freq < (double)srate))
+        return -1;
+    p = lfo->phase0 + (double)lfo->frame * lfo->incr;   // phase now
+    lfo->incr = freq / (double)srate;
+    lfo->phase0 = p - (double)lfo->frame * lfo->incr;
+    lfo->phase0 -= floor(lfo->phase0);
+    lfo->coswinc = cos(2.0 * M_PI * lfo->incr);
+    lfo->sinwinc = sin(2.0 * M_PI * lfo->incr);
+    return 0;
+}
+
+/*
+ Reading the waveform from a wavetable instead of computing it.
+ */
+void lfo_settable(LFO * lfo, const WAVETABLE * table)
+{
+    lfo->table = table;
+}
+
+/*
+ Changing the seed of the random values; the current segment is recomputed.
+ */
+void lfo_setseed(LFO * lfo, unsigned long seed)
+{
+    lfo->seed = seed;
+    lfo_seek(lfo, lfo->frame);
+}
+
+/*
+ Moving the LFO to a frame from t = 0.
+ RANDOM looks up the values at both ends of the segment it lands in.
+ */
+void lfo_seek(LFO * lfo, unsigned long frame)
+{
+    lfo->frame = frame;
+    lfo->segment = frame / lfo->step;
+    lfo->randleft = lfo_random(lfo, lfo->segment);
+    lfo->randright = lfo_random(lfo, lfo->segment + 1);
+}
+
+/*
+ Filling a block of n pan positions.
+ The phase is computed from the frame count at the start of the block
+ and accumulated within it.
+ */
+void lfo_tick_block(LFO * lfo, double * out, unsigned long n)
+{
+    const double amp = lfo->amp;
+    const double incr = lfo->incr;
+    double p = lfo->phase0 + (double)lfo->frame * incr;  // phase in cycles
+    unsigned long i;
+
+    p -= floor(p);
+    if(lfo->table != NULL){
+        const WAVETABLE * wt = lfo->table;
+        for(i = 0; i < n; i++){
+            out[i] = amp * wt_lookup(wt, p);
+            p += incr;
+            if(p >= 1.0)
+                p -= 1.0;
+        }
+        lfo->frame += n;
+        return;
+    }
+    switch(lfo->type){
+    case SINE: {
+        // rotate (c, s) by one frame per sample instead of calling sin()
+        double s = sin(2.0 * M_PI * p), c = cos(2.0 * M_PI * p), t;
+        for(i = 0; i < n; i++){
+            out[i] = amp * s;
+            t = s * lfo->coswinc + c * lfo->sinwinc;
+            c = c * lfo->coswinc - s * lfo->sinwinc;
+            s = t;
+        }
+        break;
+    }
+    case SQUARE:
+        for(i = 0; i < n; i++){
+            out[i] = p < 0.5 ? amp : -amp;
+            p += incr;
+            if(p >= 1.0)
+                p -= 1.0;
+        }
+        break;
+    case SAWTOOTH:
+        for(i = 0; i < n; i++){
+            out[i] = amp * (2.0 * p - 1.0);
+            p += incr;
+            if(p >= 1.0)
+                p -= 1.0;
+        }
+        break;
+    case TRIANGLE:
+        // peak at a quarter cycle, like asin(sin(x))
+        for(i = 0; i < n; i++){
+            if(p < 0.25)
+                out[i] = amp * (4.0 * p);
+            else if(p < 0.75)
+                out[i] = amp * (2.0 - 4.0 * p);
+            else
+                out[i] = amp * (4.0 * p - 4.0);
+            p += incr;
+            if(p >= 1.0)
+                p -= 1.0;
+        }
+        break;
+    default: { // RANDOM: linear interpolation between random values every step frames
+        unsigned long pos = lfo->frame % lfo->step;
+        for(i = 0; i < n; i++){
+            out[i] = lfo->randleft + (lfo->randright - lfo->randleft) * ((double)pos / (double)lfo->step);
+            if(++pos == lfo->step){
+                pos = 0;
+                lfo->segment++;
+                lfo->randleft = lfo->randright;
+                lfo->randright = lfo_random(lfo, lfo->segment + 1);
+            }
+        }
+        break;
+    }
+    }
+    lfo->frame += n;
+}
+
+/*
+ Returning random value k of the seed in -amp ... amp: a pure function of
+ (seed, k), from the counter-based Squares generator (Widynski 2020).
+ The key is the seed mixed by splitmix64; Squares wants an odd key with
+ well-spread bits.
+ */
+static double lfo_random(const LFO * lfo, unsigned long k)
+{
+    uint64_t key = (uint64_t)lfo->seed + 0x9e3779b97f4a7c15ULL;
+    uint64_t x, y, z;
+
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    key = (key ^ (key >> 31)) | 1;
+
+    // four rounds of squaring and swapping the halves
+    y = x = (uint64_t)k * key;
+    z = y + key;
+    x = x * x + y;  x = (x >> 32) | (x << 32);
+    x = x * x + z;  x = (x >> 32) | (x << 32);
+    x = x * x + y;  x = (x >> 32) | (x << 32);
+    x = (x * x + z) >> 32;
+    return ((double)x / 4294967296.0) * (2.0 * lfo->amp) - lfo->amp;
+}
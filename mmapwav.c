@@ -0,0 +1,219 @@
+/*
+mmapwav.c -- memory-mapped WAV files for the auto-panner
+Only the RIFF chunk list is parsed here, to find the fmt and data chunks;
+anything else about the file is left to libsndfile.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mmapwav.h>
+
+#define WAV_FORMAT_PCM        (0x0001)
+#define WAV_FORMAT_IEEE_FLOAT (0x0003)
+#define WAV_FORMAT_EXTENSIBLE (0xFFFE)
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define WAV_HOST_LE 1
+#endif
+
+static uint32_t wav_u32(const unsigned char * p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t wav_u16(const unsigned char * p) { return (uint16_t)(p[0] | p[1] << 8); }
+static void     wav_put_u32(unsigned char * p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+/*
+ Growing a file to length bytes with its blocks allocated on disk, so that
+ writing through the map can't fail on a full disk (a sparse file would
+ get SIGBUS there). Returning 0, or -1 if there is no room.
+ */
+static int wav_allocate(int fd, off_t length)
+{
+#ifdef __APPLE__
+    fstore_t store = {F_ALLOCATEALL, F_PEOFPOSMODE, 0, length, 0};
+
+    if(fcntl(fd, F_PREALLOCATE, &store) == -1)
+        return -1;
+    return ftruncate(fd, length) == 0 ? 0 : -1;
+#else
+    return posix_fallocate(fd, 0, length) == 0 ? 0 : -1;
+#endif
+}
+
+/*
+ Walking the chunks of a RIFF/WAVE file in memory.
+ Sets the fields of map from the fmt chunk and returns the offset of the
+ data chunk header, or -1 if the file is not a plain PCM 16-bit or float WAV file.
+ */
+static long wav_parse(const unsigned char * file, size_t length, WAVMAP * map)
+{
+    size_t pos = 12;
+    int gotfmt = 0;
+
+    if(length < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0)
+        return -1;
+    while(pos + 8 <= length){
+        const unsigned char * chunk = file + pos;
+        uint32_t size = wav_u32(chunk + 4);
+
+        if(memcmp(chunk, "fmt ", 4) == 0){
+            uint16_t tag, bits;
+            if(size < 16 || pos + 8 + 16 > length)
+                return -1;
+            tag = wav_u16(chunk + 8);
+            map->channels = wav_u16(chunk + 10);
+            map->samplerate = (int)wav_u32(chunk + 12);
+            bits = wav_u16(chunk + 22);
+            if(tag == WAV_FORMAT_EXTENSIBLE && size >= 40 && pos + 8 + 40 <= length)
+                tag = wav_u16(chunk + 32);  // first two bytes of the sub-format GUID
+            if(tag == WAV_FORMAT_PCM && bits == 16)
+                map->subtype = SF_FORMAT_PCM_16;
+            else if(tag == WAV_FORMAT_IEEE_FLOAT && bits == 32)
+                map->subtype = SF_FORMAT_FLOAT;
+            else
+                return -1;
+            gotfmt = 1;
+        }
+        else if(memcmp(chunk, "data", 4) == 0){
+            size_t framesize = (map->subtype == SF_FORMAT_FLOAT ? 4 : 2) * (size_t)map->channels;
+            if(!gotfmt || map->channels < 1)
+                return -1;
+            // a data chunk that runs past the end of the file is cut short
+            if(size > length - pos - 8)
+                size = (uint32_t)(length - pos - 8);
+            map->frames = size / framesize;
+            return (long)pos;
+        }
+        pos += 8 + size + (size & 1);  // chunks are padded to an even length
+    }
+    return -1;
+}
+
+/*
+ Mapping a WAV file read-only.
+ */
+int wav_map_input(const char * filename, WAVMAP * map)
+{
+#ifdef WAV_HOST_LE
+    struct stat st;
+    void * base;
+    long offset;
+    int fd;
+
+    memset(map, 0, sizeof(WAVMAP));
+    if((fd = open(filename, O_RDONLY)) < 0)
+        return -1;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 12){
+        close(fd);
+        return -1;
+    }
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // the mapping keeps the file open
+    if(base == MAP_FAILED)
+        return -1;
+    offset = wav_parse((const unsigned char *)base, (size_t)st.st_size, map);
+    if(offset < 0){
+        munmap(base, (size_t)st.st_size);  // not a file we can map
+        return -1;
+    }
+    madvise(base, (size_t)st.st_size, MADV_SEQUENTIAL);
+    map->base = base;
+    map->length = (size_t)st.st_size;
+    map->data = (char *)base + offset + 8;
+    return 0;
+#else
+    (void)filename;
+    (void)map;
+    return -1;
+#endif
+}
+
+/*
+ Creating a WAV file and mapping its data chunk read-write.
+ */
+int wav_map_output(const char * filename, SF_INFO * sfinfo, sf_count_t frames, WAVMAP * map)
+{
+#ifdef WAV_HOST_LE
+    SNDFILE * file;
+    unsigned char header[4096];
+    ssize_t headerlen;
+    size_t framesize;
+    off_t total;
+    long offset;
+    void * base;
+    int fd;
+    WAVMAP parsed;
+
+    memset(map, 0, sizeof(WAVMAP));
+    if((sfinfo->format & SF_FORMAT_TYPEMASK) != SF_FORMAT_WAV)
+        return -1;
+    framesize = ((sfinfo->format & SF_FORMAT_SUBMASK) == SF_FORMAT_FLOAT ? 4 : 2) * (size_t)sfinfo->channels;
+
+    // let libsndfile write the header of an empty file (no PEAK chunk: its values would be stale)
+    if((file = sf_open(filename, SFM_WRITE, sfinfo)) == NULL)
+        return -1;
+    sf_command(file, SFC_SET_ADD_PEAK_CHUNK, NULL, SF_FALSE);
+    sf_close(file);
+
+    if((fd = open(filename, O_RDWR)) < 0)
+        return -1;
+    if((headerlen = read(fd, header, sizeof(header))) < 0){
+        close(fd);
+        return -1;
+    }
+    offset = wav_parse(header, (size_t)headerlen, &parsed);
+    total = offset + 8 + (off_t)(frames * framesize);
+    if(offset < 0 || parsed.subtype != (sfinfo->format & SF_FORMAT_SUBMASK)
+       || total - 8 > 0xFFFFFFFFLL){
+        close(fd);
+        return -1;  // not a layout we understand, or too big for a RIFF file
+    }
+
+    // size the data chunk and fix the sizes in the header
+    if(wav_allocate(fd, total) != 0){
+        close(fd);
+        return -1;
+    }
+    base = mmap(NULL, (size_t)total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+        return -1;
+    wav_put_u32((unsigned char *)base + 4, (uint32_t)(total - 8));
+    wav_put_u32((unsigned char *)base + offset + 4, (uint32_t)(frames * framesize));
+    map->base = base;
+    map->length = (size_t)total;
+    map->data = (char *)base + offset + 8;
+    map->frames = frames;
+    map->channels = sfinfo->channels;
+    map->samplerate = sfinfo->samplerate;
+    map->subtype = parsed.subtype;
+    return 0;
+#else
+    (void)filename;
+    (void)sfinfo;
+    (void)frames;
+    (void)map;
+    return -1;
+#endif
+}
+
+/*
+ Unmapping a file.
+ */
+int wav_unmap(WAVMAP * map)
+{
+    int result = 0;
+
+    if(map->base != NULL){
+        if(msync(map->base, map->length, MS_ASYNC) != 0)
+            result = -1;
+        if(munmap(map->base, map->length) != 0)
+            result = -1;
+    }
+    memset(map, 0, sizeof(WAVMAP));
+    return result;
+}
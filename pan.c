@@ -0,0 +1,319 @@
+/*
+pan.c -- constant power panning for the auto-panner
+constpower function written by Richard Dobson
+The table version avoids calling sin and cos for every sample.
+*/
+
+#include <math.h>
+#include <pthread.h>
+#include <pan.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PAN_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define PAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+double cp_table[CP_SIZE + 2];   // see pan.h; the right gain reads it mirrored
+static pthread_once_t pan_once = PTHREAD_ONCE_INIT;
+
+static void cp_build(void);                          // fill the table
+static void pan_setup(void);                         // the table and the kernels
+
+PANAMPS constpower(double position)
+{
+    PANAMPS amps;  // amplitudes for left & right channels
+    const double  piovr2    = 4.0 * atan(1.0) * 0.5;    /* pi/2: 1/4 cycle of a sinusoid */
+    const double  root2ovr2 = sqrt(2.0) * 0.5;         /* sqrt(2)/2: 1/4 amplitude of a sinusoid */
+    double thispos = position * piovr2;                    /* scale position to fit the pi/2 range */
+    double angle = thispos * 0.5;                         /* each channel uses a 1/4 of a cycle */
+    
+    amps.left    = root2ovr2 * (cos(angle) - sin(angle));
+    amps.right    = root2ovr2 * (cos(angle) + sin(angle));
+    return amps;
+}
+
+/*
+ Table version of constpower.
+ */
+PANAMPS constpower_fast(double position)
+{
+    PANAMPS amps;
+
+    amps.left = cp_gain(position);
+    amps.right = cp_gain(-position);
+    return amps;
+}
+
+/*
+ Table version of constpower for a block of positions.
+ */
+void constpower_block(const double * position, float * left, float * right, unsigned long n)
+{
+    for(unsigned long i = 0; i < n; i++){
+        left[i] = (float)cp_gain(position[i]);
+        right[i] = (float)cp_gain(-position[i]);
+    }
+}
+
+// a gain of 0.0 ... 1.0 in Q15, rounded; 1.0 itself becomes 32767
+static inline short pan_toq15(double gain)
+{
+    return (short)(gain >= 32767.0 / 32768.0 ? 32767 : gain * 32768.0 + 0.5);
+}
+
+// the same in Q31
+static inline int pan_toq31(double gain)
+{
+    return (int)(gain >= 2147483647.0 / 2147483648.0 ? 2147483647 : gain * 2147483648.0 + 0.5);
+}
+
+/*
+ Table version of constpower for a block of positions, as Q15 or Q31 integer gains.
+ */
+void constpower_block_q15(const double * position, short * left, short * right, unsigned long n)
+{
+    for(unsigned long i = 0; i < n; i++){
+        left[i] = pan_toq15(cp_gain(position[i]));
+        right[i] = pan_toq15(cp_gain(-position[i]));
+    }
+}
+
+void constpower_block_q31(const double * position, int * left, int * right, unsigned long n)
+{
+    for(unsigned long i = 0; i < n; i++){
+        left[i] = pan_toq31(cp_gain(position[i]));
+        right[i] = pan_toq31(cp_gain(-position[i]));
+    }
+}
+
+static void cp_build(void)
+{
+    for(int i = 0; i <= CP_SIZE; i++)
+        cp_table[i] = cos((double)i / CP_SIZE * M_PI * 0.5);
+    cp_table[CP_SIZE + 1] = cp_table[CP_SIZE];  // x = 1.0 reads one past the end
+}
+
+/******** pan and interleave kernels **************/
+
+static void pan_interleave_scalar(const float * in, const float * left, const float * right,
+                                  float * out, unsigned long n)
+{
+    for(unsigned long i = 0; i < n; i++){
+        out[2*i]   = in[i] * left[i];
+        out[2*i+1] = in[i] * right[i];
+    }
+}
+
+#ifdef PAN_X86
+__attribute__((target("sse2")))
+static void pan_interleave_sse2(const float * in, const float * left, const float * right,
+                                float * out, unsigned long n)
+{
+    unsigned long i = 0;
+
+    for(; i + 4 <= n; i += 4){
+        __m128 x = _mm_loadu_ps(in + i);
+        __m128 l = _mm_mul_ps(x, _mm_loadu_ps(left + i));
+        __m128 r = _mm_mul_ps(x, _mm_loadu_ps(right + i));
+        _mm_storeu_ps(out + 2*i,     _mm_unpacklo_ps(l, r));  // l0 r0 l1 r1
+        _mm_storeu_ps(out + 2*i + 4, _mm_unpackhi_ps(l, r));  // l2 r2 l3 r3
+    }
+    pan_interleave_scalar(in + i, left + i, right + i, out + 2*i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void pan_interleave_avx2(const float * in, const float * left, const float * right,
+                                float * out, unsigned long n)
+{
+    unsigned long i = 0;
+
+    for(; i + 8 <= n; i += 8){
+        __m256 x = _mm256_loadu_ps(in + i);
+        __m256 l = _mm256_mul_ps(x, _mm256_loadu_ps(left + i));
+        __m256 r = _mm256_mul_ps(x, _mm256_loadu_ps(right + i));
+        __m256 lo = _mm256_unpacklo_ps(l, r);  // l0 r0 l1 r1 | l4 r4 l5 r5
+        __m256 hi = _mm256_unpackhi_ps(l, r);  // l2 r2 l3 r3 | l6 r6 l7 r7
+        _mm256_storeu_ps(out + 2*i,     _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + 2*i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    pan_interleave_scalar(in + i, left + i, right + i, out + 2*i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void pan_interleave_avx512(const float * in, const float * left, const float * right,
+                                  float * out, unsigned long n)
+{
+    const __m512i idxlo = _mm512_setr_epi32(0,16,1,17,2,18,3,19,4,20,5,21,6,22,7,23);
+    const __m512i idxhi = _mm512_setr_epi32(8,24,9,25,10,26,11,27,12,28,13,29,14,30,15,31);
+    unsigned long i = 0;
+
+    for(; i + 16 <= n; i += 16){
+        __m512 x = _mm512_loadu_ps(in + i);
+        __m512 l = _mm512_mul_ps(x, _mm512_loadu_ps(left + i));
+        __m512 r = _mm512_mul_ps(x, _mm512_loadu_ps(right + i));
+        _mm512_storeu_ps(out + 2*i,      _mm512_permutex2var_ps(l, idxlo, r));
+        _mm512_storeu_ps(out + 2*i + 16, _mm512_permutex2var_ps(l, idxhi, r));
+    }
+    pan_interleave_avx2(in + i, left + i, right + i, out + 2*i, n - i);
+}
+#endif
+
+#ifdef PAN_NEON
+static void pan_interleave_neon(const float * in, const float * left, const float * right,
+                                float * out, unsigned long n)
+{
+    unsigned long i = 0;
+
+    for(; i + 4 <= n; i += 4){
+        float32x4_t x = vld1q_f32(in + i);
+        float32x4x2_t lr;
+        lr.val[0] = vmulq_f32(x, vld1q_f32(left + i));
+        lr.val[1] = vmulq_f32(x, vld1q_f32(right + i));
+        vst2q_f32(out + 2*i, lr);  // interleaving store
+    }
+    pan_interleave_scalar(in + i, left + i, right + i, out + 2*i, n - i);
+}
+#endif
+
+/******** integer pan and interleave kernels **************/
+
+// in * gain / 32768, rounded and saturated: what mulhrs and vqrdmulh compute
+static inline short pan_q15(int x, int gain)
+{
+    int y = (x * gain + 16384) >> 15;
+    return (short)(y > 32767 ? 32767 : y < -32768 ? -32768 : y);
+}
+
+static void pan_interleave_s16_scalar(const short * in, const short * left, const short * right,
+                                      short * out, unsigned long n)
+{
+    for(unsigned long i = 0; i < n; i++){
+        out[2*i]   = pan_q15(in[i], left[i]);
+        out[2*i+1] = pan_q15(in[i], right[i]);
+    }
+}
+
+#ifdef PAN_X86
+__attribute__((target("ssse3")))
+static void pan_interleave_s16_ssse3(const short * in, const short * left, const short * right,
+                                     short * out, unsigned long n)
+{
+    unsigned long i = 0;
+
+    for(; i + 8 <= n; i += 8){
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i l = _mm_mulhrs_epi16(x, _mm_loadu_si128((const __m128i *)(left + i)));
+        __m128i r = _mm_mulhrs_epi16(x, _mm_loadu_si128((const __m128i *)(right + i)));
+        _mm_storeu_si128((__m128i *)(out + 2*i),     _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i *)(out + 2*i + 8), _mm_unpackhi_epi16(l, r));
+    }
+    pan_interleave_s16_scalar(in + i, left + i, right + i, out + 2*i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void pan_interleave_s16_avx2(const short * in, const short * left, const short * right,
+                                    short * out, unsigned long n)
+{
+    unsigned long i = 0;
+
+    for(; i + 16 <= n; i += 16){
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i l = _mm256_mulhrs_epi16(x, _mm256_loadu_si256((const __m256i *)(left + i)));
+        __m256i r = _mm256_mulhrs_epi16(x, _mm256_loadu_si256((const __m256i *)(right + i)));
+        __m256i lo = _mm256_unpacklo_epi16(l, r);  // frames 0-3 | 8-11
+        __m256i hi = _mm256_unpackhi_epi16(l, r);  // frames 4-7 | 12-15
+        _mm256_storeu_si256((__m256i *)(out + 2*i),      _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + 2*i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    pan_interleave_s16_ssse3(in + i, left + i, right + i, out + 2*i, n - i);
+}
+#endif
+
+#ifdef PAN_NEON
+static void pan_interleave_s16_neon(const short * in, const short * left, const short * right,
+                                    short * out, unsigned long n)
+{
+    unsigned long i = 0;
+
+    for(; i + 8 <= n; i += 8){
+        int16x8_t x = vld1q_s16(in + i);
+        int16x8x2_t lr;
+        lr.val[0] = vqrdmulhq_s16(x, vld1q_s16(left + i));
+        lr.val[1] = vqrdmulhq_s16(x, vld1q_s16(right + i));
+        vst2q_s16(out + 2*i, lr);
+    }
+    pan_interleave_s16_scalar(in + i, left + i, right + i, out + 2*i, n - i);
+}
+#endif
+
+/*
+ The 32-bit kernel; the products need 64 bits, which leaves it to the compiler.
+ */
+void pan_interleave_s32(const int * in, const int * left, const int * right,
+                        int * out, unsigned long n)
+{
+    const long long half = 1LL << 30;
+
+    for(unsigned long i = 0; i < n; i++){
+        // |in * gain| < 2^62 and gain < 1.0, so the result fits again
+        out[2*i]   = (int)(((long long)in[i] * left[i] + half) >> 31);
+        out[2*i+1] = (int)(((long long)in[i] * right[i] + half) >> 31);
+    }
+}
+
+void (*pan_interleave)(const float * in, const float * left, const float * right,
+                       float * out, unsigned long n) = pan_interleave_scalar;
+void (*pan_interleave_s16)(const short * in, const short * left, const short * right,
+                           short * out, unsigned long n) = pan_interleave_s16_scalar;
+static const char * pan_kernel = "scalar";
+
+/*
+ Building the table and picking the kernels, once for the process.
+ */
+void pan_init(void)
+{
+    pthread_once(&pan_once, pan_setup);
+}
+
+/*
+ Filling cp_table and picking the pan_interleave and pan_interleave_s16
+ kernels for this CPU.
+ */
+static void pan_setup(void)
+{
+    cp_build();
+#ifdef PAN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        pan_interleave_s16 = pan_interleave_s16_avx2;
+    else if(__builtin_cpu_supports("ssse3"))
+        pan_interleave_s16 = pan_interleave_s16_ssse3;
+    if(__builtin_cpu_supports("avx512f")){
+        pan_interleave = pan_interleave_avx512;
+        pan_kernel = "avx512";
+    }
+    else if(__builtin_cpu_supports("avx2")){
+        pan_interleave = pan_interleave_avx2;
+        pan_kernel = "avx2";
+    }
+    else if(__builtin_cpu_supports("sse2")){
+        pan_interleave = pan_interleave_sse2;
+        pan_kernel = "sse2";
+    }
+#elif defined(PAN_NEON)
+    pan_interleave = pan_interleave_neon;
+    pan_interleave_s16 = pan_interleave_s16_neon;
+    pan_kernel = "neon";
+#endif
+}
+
+/*
+ Returning the name of the kernel pan_interleave points to.
+ */
+const char * pan_kernelname(void)
+{
+    return pan_kernel;
+}
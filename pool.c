@@ -0,0 +1,112 @@
+/*
+pool.c -- a fixed-size work-stealing thread pool
+Each worker owns a deque of task indices. It takes its own tasks from the
+front and, once its deque is empty, steals from the back of the others.
+The tasks are whole renders, so a mutex per deque costs nothing measurable.
+*/
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <pool.h>
+
+typedef struct pool_deque {
+    pthread_mutex_t lock;
+    int *   tasks;       // task indices
+    int     front;       // next task for the owner
+    int     back;        // one past the last task; thieves take tasks[back - 1]
+} POOLDEQUE;
+
+typedef struct pool_worker {
+    pthread_t   thread;
+    int         index;       // worker index
+    int         nworkers;
+    POOLDEQUE * deques;      // the deques of all workers
+    POOLTASK    run;
+    void *      context;
+} POOLWORKER;
+
+/*
+ Taking a task from the front (owner) or the back (thief) of a deque.
+ Returning the task index or -1 if the deque is empty.
+ */
+static int pool_take(POOLDEQUE * deque, int steal)
+{
+    int task = -1;
+
+    pthread_mutex_lock(&deque->lock);
+    if(deque->front < deque->back)
+        task = steal ? deque->tasks[--deque->back] : deque->tasks[deque->front++];
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static void * pool_work(void * arg)
+{
+    POOLWORKER * w = (POOLWORKER *)arg;
+    int task;
+
+    for(;;){
+        task = pool_take(&w->deques[w->index], 0);
+        // out of work: steal from the next workers in turn
+        for(int i = 1; task < 0 && i < w->nworkers; i++)
+            task = pool_take(&w->deques[(w->index + i) % w->nworkers], 1);
+        if(task < 0)
+            break;  // no tasks are ever added, so all deques are empty for good
+        w->run(task, w->index, w->context);
+    }
+    return NULL;
+}
+
+/*
+ Running tasks 0 ... ntasks - 1 on nworkers threads.
+ */
+int pool_run(int nworkers, int ntasks, POOLTASK run, void * context)
+{
+    POOLDEQUE * deques;
+    POOLWORKER * workers;
+    int * tasks;
+    int i, started = 0;
+
+    if(nworkers < 1 || ntasks < 0)
+        return -1;
+    deques = (POOLDEQUE *)malloc(nworkers * sizeof(POOLDEQUE));
+    workers = (POOLWORKER *)malloc(nworkers * sizeof(POOLWORKER));
+    tasks = (int *)malloc((ntasks + 1) * sizeof(int));
+    if(deques == NULL || workers == NULL || tasks == NULL){
+        free(deques);
+        free(workers);
+        free(tasks);
+        return -1;
+    }
+
+    // worker i starts with a contiguous share of the tasks, in order
+    for(i = 0; i < ntasks; i++)
+        tasks[i] = i;
+    for(i = 0; i < nworkers; i++){
+        pthread_mutex_init(&deques[i].lock, NULL);
+        deques[i].tasks = tasks;
+        deques[i].front = (int)((long)ntasks * i / nworkers);
+        deques[i].back = (int)((long)ntasks * (i + 1) / nworkers);
+    }
+
+    for(i = 0; i < nworkers; i++){
+        workers[i].index = i;
+        workers[i].nworkers = nworkers;
+        workers[i].deques = deques;
+        workers[i].run = run;
+        workers[i].context = context;
+        if(pthread_create(&workers[i].thread, NULL, pool_work, &workers[i]) != 0)
+            break;
+        started++;
+    }
+    // if some threads failed to start, the others steal their tasks
+    for(i = 0; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    for(i = 0; i < nworkers; i++)
+        pthread_mutex_destroy(&deques[i].lock);
+    free(deques);
+    free(workers);
+    free(tasks);
+    return started > 0 ? 0 : -1;
+}
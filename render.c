@@ -0,0 +1,854 @@
+/*
+render.c -- rendering for the auto-panner
+Pans a mono sound file into a stereo sound file with an LFO, block by block,
+on one thread or on several threads.
+Adapted from sfpan.c by Minglun Lee
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>    // for uintptr_t
+#include <string.h>
+#include <unistd.h>    // for STDIN_FILENO
+#include <math.h>      // for M_PI
+#include <pthread.h>
+#include <sndfile.h>
+#include <breakpoints.h>
+#include <lfo.h>
+#include <pan.h>
+#include <render.h>
+#include <ringbuf.h>
+#include <mmapwav.h>
+#include <stats.h>
+#include <kernels.h>
+
+/* PIPEBLOCK is a slot of the rings between the pipeline stages */
+typedef struct pipe_block {
+    long  count;     // frames in the block; 0 marks the end of the file
+    float data[];    // mono or stereo samples
+} PIPEBLOCK;
+
+/* PIPESTAGE is the reader or the writer of the pipeline */
+typedef struct pipe_stage {
+    pthread_t thread;
+    SNDFILE * file;      // file read or written by the stage
+    RINGBUF * ring;      // ring filled by the reader, or emptied by the writer
+    long      nframes;   // frames per block
+    int       error;     // set by the writer if a write failed
+} PIPESTAGE;
+
+/* RENDERTHREAD is one worker of a multithreaded render.
+   Each worker reads its own chunk of the input through its own handle,
+   with its own copy of the LFO moved to the first frame of the chunk. */
+typedef struct render_thread {
+    pthread_t  thread;
+    SNDFILE *  infile;     // own handle on the input file
+    LFO        lfo;        // own copy of the LFO
+    RENDERKERNEL kernel;   // fused kernel of the LFO, or NULL for pan_block
+    sf_count_t start;      // first frame of the chunk
+    sf_count_t count;      // frames in the chunk; set to the frames rendered
+    long       nframes;    // frames per block
+    float *    inbuffer;   // mono input, one block
+    double *   posbuffer;  // stereo positions, one block
+    float *    leftgain;   // left channel gains, one block
+    float *    rightgain;  // right channel gains, one block
+    float *    outbuffer;  // stereo output for the whole chunk
+} RENDERTHREAD;
+
+static int export_isbinary(const char * name);
+static int export_close(FILE * fp, int binary, const char * name);
+static void export_block(FILE * fp, int binary, const double * pos, sf_count_t frame, long n,
+                         int srate);
+static sf_count_t render_mapped(const char * infilename, const char * outfilename, LFO * lfo,
+                                PANBUFFERS * buf, FILE * fp, int binary, SF_INFO * sfinfo,
+                                int intpcm, RENDERSTATS * stats);
+static sf_count_t render_integer(SNDFILE * infile, SNDFILE * outfile, LFO * lfo, PANBUFFERS * buf,
+                                 FILE * fp, int binary, int srate, int subtype,
+                                 RENDERSTATS * stats);
+static sf_count_t render_pipeline(SNDFILE * infile, SNDFILE * outfile, LFO * lfo,
+                                  PANBUFFERS * buf, FILE * fp, int binary, int srate);
+
+/*
+ Allocating the block buffers of a render, nframes frames per block.
+ */
+int panbuffers_alloc(PANBUFFERS * buf, long nframes)
+{
+    buf->nframes = nframes;
+    buf->inbuffer = (float *)malloc(nframes * sizeof(float)); // used to save a block of samples
+    buf->outbuffer = (float *)malloc(2 * nframes * sizeof(float)); // for stereo
+    buf->posbuffer = (double *)malloc(nframes * sizeof(double)); // for the LFO
+    buf->leftgain = (float *)malloc(nframes * sizeof(float));
+    buf->rightgain = (float *)malloc(nframes * sizeof(float));
+    buf->inpcm = (int *)malloc(nframes * sizeof(int)); // for the integer path
+    buf->outpcm = (int *)malloc(2 * nframes * sizeof(int));
+    buf->leftfix = (int *)malloc(nframes * sizeof(int));
+    buf->rightfix = (int *)malloc(nframes * sizeof(int));
+    if(buf->inbuffer == NULL || buf->outbuffer == NULL || buf->posbuffer == NULL
+       || buf->leftgain == NULL || buf->rightgain == NULL || buf->inpcm == NULL
+       || buf->outpcm == NULL || buf->leftfix == NULL || buf->rightfix == NULL){
+        panbuffers_free(buf);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ Releasing the block buffers of a render.
+ */
+void panbuffers_free(PANBUFFERS * buf)
+{
+    free(buf->inbuffer);
+    free(buf->outbuffer);
+    free(buf->posbuffer);
+    free(buf->leftgain);
+    free(buf->rightgain);
+    free(buf->inpcm);
+    free(buf->outpcm);
+    free(buf->leftfix);
+    free(buf->rightfix);
+    memset(buf, 0, sizeof(PANBUFFERS));
+}
+
+/*
+ Checking the width, rate and phase and looking up the panning type.
+ */
+int check_params(double width, double rate, double phase, const char * typestr, int * type)
+{
+    // validate the width
+    if(width < 0.5 ||width > 1.0)
+    {
+        printf("Error: amount must be between 0.5 and 1.0.\n");
+        return 1;
+    }
+
+    // validate the rate
+    if(rate < 0.0 || rate > 10)
+    {
+        printf("Error: rate must be between 0.0 and 10.0\n");
+        return 1;
+    }
+
+    // validate the phase
+    if(phase < 0.0 || phase > 2*M_PI)
+    {
+        printf("Error: phase must be between 0.0 and 2*pi.\n");
+        return 1;
+    }
+
+    // validate the panning type
+    *type = lfo_type(typestr);
+    if(*type == -1)
+    {
+        printf("Error: panning type must be sine, square, sawtooth, triangle, or random.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ Determine the file major type with the file extension (e.g. wav, aif, aiff).
+ Return the major type format in hex.
+ */
+int sf_extension(const char * filename){
+    int filename_len = strlen(filename); // entire filename length (include the extension)
+    if(strcmp((filename + (filename_len - 4)), ".wav") == 0){
+        return SF_FORMAT_WAV;     // wav file type in hex
+    }
+    else if(strcmp((filename + (filename_len - 4)), ".aif") == 0
+        || strcmp((filename + (filename_len - 5)), ".aiff") == 0){
+        return SF_FORMAT_AIFF;   // aiff or aif file type in hex
+    }
+    else if(strcmp((filename + (filename_len - 4)), ".w64") == 0){
+        return SF_FORMAT_W64;    // Sony Wave64, for files past the 4 GB of WAV
+    }
+    else {
+        return -1;               // extension is not wav, aiff, or aif
+    }
+}
+
+/*
+ Looking up the sample format of a headerless input: s16, s24, s32 or f32,
+ all little-endian. Returning the libsndfile subtype and endianness, or 0.
+ */
+int raw_subtype(const char * name)
+{
+    if(strcmp(name, "s16") == 0)
+        return SF_FORMAT_PCM_16 | SF_ENDIAN_LITTLE;
+    else if(strcmp(name, "s24") == 0)
+        return SF_FORMAT_PCM_24 | SF_ENDIAN_LITTLE;
+    else if(strcmp(name, "s32") == 0)
+        return SF_FORMAT_PCM_32 | SF_ENDIAN_LITTLE;
+    else if(strcmp(name, "f32") == 0)
+        return SF_FORMAT_FLOAT | SF_ENDIAN_LITTLE;
+    return 0;
+}
+
+/*
+ Rendering one job: open the files, set up the LFO and pan block by block.
+ */
+int render_job(AUTOPANJOB * job, PANBUFFERS * buf)
+{
+    SNDFILE * infile = NULL;   // input sound file pointer
+    SNDFILE * outfile = NULL;  // output sound file pointer
+    SF_INFO sfinfo;            // sound file info
+    FILE * fp = NULL;          // for breakpoint file
+    int binary;                // fp is a binary breakpoint file
+    int intpcm;                // pan PCM as integers (job->intpcm, on one thread)
+    LFO     lfo;               // oscillator for the stereo positions
+    RENDERKERNEL kernel;       // fused render loop, or NULL
+    int subtype;               // sample format of the input and output
+    long readcount;            // no. of samples read
+    sf_count_t frame = 0;      // frames processed so far
+    int nthreads = job->nthreads;
+    int instream = strcmp(job->infilename, "-") == 0;    // reading stdin
+    int outstream = strcmp(job->outfilename, "-") == 0;  // writing stdout
+
+    job->frames = 0;
+    job->samplerate = 0;
+    pan_init();                // the gain table and kernels, on the first job
+
+    // check if the input file name and output file name are the same
+    if(strcmp(job->infilename, job->outfilename) == 0 && !instream)
+    {
+        printf("Error: input file name and output file name cannot be the same.\n");
+        return 1;
+    }
+
+    //open the sound file for reading
+    memset(&sfinfo, 0, sizeof(sfinfo)); // clear the SF_INFO struct
+    if(job->rawformat != 0){
+        // a headerless input has to be described up front
+        sfinfo.format = SF_FORMAT_RAW | job->rawformat;
+        sfinfo.channels = 1;
+        sfinfo.samplerate = job->rawrate;
+    }
+    if(instream)
+        infile = sf_open_fd(STDIN_FILENO, SFM_READ, &sfinfo, 0);
+    else
+        infile = sf_open(job->infilename, SFM_READ, &sfinfo);
+    if(infile == NULL)
+    {
+        printf("Not able to open input file %s.\n", job->infilename) ;
+        puts(sf_strerror (NULL));
+        return 1;
+    }
+
+    job->samplerate = sfinfo.samplerate;
+    if(sfinfo.channels != 1){
+        printf("Error: Input file is not mono!\n");
+        sf_close(infile);
+        return 1;
+    }
+
+    //set up the LFO; it runs at the sample rate of the input file
+    if(lfo_init(&lfo, job->type, job->width, job->rate, job->phase, sfinfo.samplerate) != 0){
+        printf("Error: invalid sample rate (it must be above the rate).\n");
+        sf_close(infile);
+        return 1;
+    }
+    lfo_setseed(&lfo, job->seed);
+    // a custom shape replaces the waveform of the panning type
+    if(job->shape != NULL)
+        lfo_settable(&lfo, job->shape);
+    else if(job->smooth && job->type != RANDOM)
+        lfo_settable(&lfo, wt_get(job->type, 1));
+
+    if(outstream){
+        // stdout can't seek back to fill in a WAV or AIFF header: raw in, raw out, else AU
+        sfinfo.format = (job->rawformat != 0 ? SF_FORMAT_RAW | SF_ENDIAN_LITTLE : SF_FORMAT_AU)
+                        | (sfinfo.format & SF_FORMAT_SUBMASK);
+    }
+    else if(sf_extension(job->outfilename) == -1){
+        printf("The outfile extension is not .wav, .aif, .aiff or .w64\n");
+        sf_close(infile);
+        return 1;
+    }
+    else if(job->rawformat != 0)
+        sfinfo.format = sf_extension(job->outfilename) | (sfinfo.format & SF_FORMAT_SUBMASK);
+    
+    sfinfo.channels = 2; // stereo for output file
+
+     if(!sf_format_check(&sfinfo))  // check sfinfo for outfile
+    {
+        printf ("Invalid encoding\n") ;
+        sf_close(infile) ;
+        return 1;
+    }
+    
+    // each thread renders its chunks on its own, which needs an LFO that
+    // can start anywhere (all types can) and an input it can open and seek;
+    // --export needs every block, and streams and raw input can't be reopened
+    if(nthreads > 1 && (job->exportname != NULL || instream || job->rawformat != 0))
+    {
+        printf("Note: rendering on one thread for %s.\n",
+               job->exportname != NULL ? "--export" : instream ? "stdin" : "raw input");
+        nthreads = 1;
+    }
+    // the threaded and pipelined renders pan through float only
+    intpcm = job->intpcm;
+    if(intpcm && (nthreads > 1 || job->pipeline))
+    {
+        printf("Note: --integer is not used with %s; panning through float.\n",
+               nthreads > 1 ? "--threads" : "--pipeline");
+        intpcm = 0;
+    }
+
+    //optionally export the breakpoints for debugging, binary for a .brk name
+    binary = job->exportname != NULL && export_isbinary(job->exportname);
+    if(job->exportname != NULL && ((fp = fopen(job->exportname, binary ? "wb" : "w")) == NULL
+                                   || (binary && write_brkheader(fp, BRK_TOEND) != 0)))
+    {
+        if(fp != NULL)
+            fclose(fp);
+        printf("Error: unable to write breakpoint file %s\n", job->exportname);
+        sf_close(infile);
+        return 1;
+    }
+
+    // a WAV file can be rendered in place through memory maps
+    if(job->mmap && nthreads == 1 && !job->pipeline && !instream && !outstream
+       && job->rawformat == 0 && (sfinfo.format & SF_FORMAT_TYPEMASK) == SF_FORMAT_WAV)
+    {
+        job->frames = render_mapped(job->infilename, job->outfilename, &lfo, buf, fp, binary,
+                                    &sfinfo, intpcm, job->stats);
+        if(job->frames != -2)
+        {
+            if(job->frames < 0)
+                printf("Error: memory-mapped rendering failed.\n");
+            if(fp != NULL && export_close(fp, binary, job->exportname) != 0)
+                job->frames = -1;
+            sf_close(infile);
+            stats_mark(job->stats, STAGE_FINISH);
+            return job->frames < 0 ? 1 : 0;
+        }
+        printf("Note: %s can't be memory-mapped, using libsndfile.\n", job->infilename);
+    }
+
+    // open a sound file for writing with sfinfo
+    if(outstream)
+        outfile = sf_open_fd(job->outfd, SFM_WRITE, &sfinfo, 0);
+    else
+        outfile = sf_open(job->outfilename, SFM_WRITE, &sfinfo);
+    if(outfile == NULL)
+    {
+        printf("Not able to open output file %s.\n", job->outfilename) ;
+        puts(sf_strerror (NULL));
+        if(fp != NULL)
+            fclose(fp);
+        sf_close(infile) ;
+        return 1 ;
+    }
+
+    stats_mark(job->stats, STAGE_SETUP);
+    if(nthreads > 1)
+    {
+        job->frames = render_threads(job->infilename, outfile, &lfo, nthreads, buf->nframes);
+        stats_mark(job->stats, STAGE_RENDER);
+        if(job->frames < 0)
+            printf("Error: multithreaded rendering failed.\n");
+        sf_close(infile);
+        sf_close(outfile);
+        stats_mark(job->stats, STAGE_FINISH);
+        return job->frames < 0 ? 1 : 0;
+    }
+
+    if(job->pipeline)
+    {
+        // reading, panning and writing overlap on three threads
+        job->frames = render_pipeline(infile, outfile, &lfo, buf, fp, binary, sfinfo.samplerate);
+        stats_mark(job->stats, STAGE_RENDER);
+        if(job->frames < 0)
+            printf("Error: pipelined rendering failed.\n");
+        if(fp != NULL && export_close(fp, binary, job->exportname) != 0)
+            job->frames = -1;
+        sf_close(infile);
+        sf_close(outfile);
+        stats_mark(job->stats, STAGE_FINISH);
+        return job->frames < 0 ? 1 : 0;
+    }
+
+    subtype = sfinfo.format & SF_FORMAT_SUBMASK;
+    if(intpcm && (subtype == SF_FORMAT_PCM_16 || subtype == SF_FORMAT_PCM_24
+                  || subtype == SF_FORMAT_PCM_32))
+    {
+        // integer PCM is panned as it is read, without converting it to float
+        job->frames = render_integer(infile, outfile, &lfo, buf, fp, binary, sfinfo.samplerate,
+                                     subtype, job->stats);
+        if(fp != NULL && export_close(fp, binary, job->exportname) != 0)
+            job->frames = -1;
+        sf_close(infile);
+        sf_close(outfile);
+        stats_mark(job->stats, STAGE_FINISH);
+        return job->frames < 0 ? 1 : 0;
+    }
+
+    //processing autopanning; without --export and --stats the positions aren't
+    //kept and the fused kernel of the waveform does it in one loop, otherwise
+    //the steps of pan_block run one by one, so --stats can time each step
+    //(the output is the same)
+    kernel = fp == NULL && job->stats == NULL ? render_kernel(&lfo, KERNEL_FLOAT) : NULL;
+    while ((readcount = sf_read_float(infile, buf->inbuffer, buf->nframes)) > 0){
+        stats_mark(job->stats, STAGE_DECODE);
+        if(kernel != NULL)
+            kernel(&lfo, buf->inbuffer, buf->outbuffer, readcount);
+        else{
+            // get the stereo positions for the whole block
+            lfo_tick_block(&lfo, buf->posbuffer, readcount);
+            stats_mark(job->stats, STAGE_LFO);
+            constpower_block(buf->posbuffer, buf->leftgain, buf->rightgain, readcount);
+            pan_interleave(buf->inbuffer, buf->leftgain, buf->rightgain, buf->outbuffer, readcount);
+        }
+        stats_mark(job->stats, STAGE_PAN);
+        sf_write_float(outfile, buf->outbuffer, 2 * readcount) ;
+        stats_mark(job->stats, STAGE_ENCODE);
+        if(fp != NULL){
+            export_block(fp, binary, buf->posbuffer, frame, readcount, sfinfo.samplerate);
+            stats_mark(job->stats, STAGE_EXPORT);
+        }
+        frame += readcount;
+    }    // read block by block until the end of the sound file
+    stats_mark(job->stats, STAGE_DECODE);  // the read at the end of the file
+    job->frames = frame;
+
+      /* clean up */
+    if(fp != NULL && export_close(fp, binary, job->exportname) != 0)
+        job->frames = -1;   // close the breakpoint file
+    sf_close(infile) ;   // close input sound file
+    sf_close(outfile) ;  // close output sound file
+    stats_mark(job->stats, STAGE_FINISH);
+    return job->frames < 0 ? 1 : 0;
+}
+
+/*
+ Checking for the .brk extension of a binary breakpoint file.
+ */
+static int export_isbinary(const char * name)
+{
+    size_t len = strlen(name);
+
+    return len >= 4 && strcmp(name + len - 4, ".brk") == 0;
+}
+
+/*
+ Closing the breakpoint file of --export. A binary file that can seek gets
+ the real point count in its header instead of BRK_TOEND; the count follows
+ from the length, since the points come right after the header.
+ Returning 0, or -1 (with a message) if anything failed to be written.
+ */
+static int export_close(FILE * fp, int binary, const char * name)
+{
+    long end;
+    int result = 0;
+
+    if(binary && (end = ftell(fp)) >= (long)sizeof(BRKHEADER) && fseek(fp, 0, SEEK_SET) == 0)
+        result = write_brkheader(fp, (uint64_t)(end - sizeof(BRKHEADER)) / sizeof(BREAKPOINT));
+    if(ferror(fp))
+        result = -1;
+    if(fclose(fp) != 0)
+        result = -1;
+    if(result != 0)
+        printf("Error: unable to write breakpoint file %s\n", name);
+    return result;
+}
+
+/*
+ Writing the stereo positions of a block to the breakpoint file,
+ one position every LFO_STEP frames. frame is the first frame of the block.
+ A binary file gets the raw points after the header written by render_job.
+ A failed write stops the block; the error stays on fp for export_close.
+ */
+static void export_block(FILE * fp, int binary, const double * pos, sf_count_t frame, long n,
+                         int srate)
+{
+    for(long i = (LFO_STEP - frame % LFO_STEP) % LFO_STEP; i < n; i += LFO_STEP){
+        BREAKPOINT point = {(double)(frame + i) / srate, pos[i]};
+        if(binary ? fwrite(&point, sizeof(BREAKPOINT), 1, fp) != 1
+                  : write_breakpoints(fp, &point, 1) != 0)
+            return;
+    }
+}
+
+/*
+ Panning one block of n frames: stereo positions from the LFO, constant
+ power gains, then the mono input times the gains into interleaved stereo.
+ pos, left and right are scratch buffers of at least n values.
+ */
+void pan_block(LFO * lfo, const float * in, float * out, long n,
+               double * pos, float * left, float * right)
+{
+    lfo_tick_block(lfo, pos, n);
+    constpower_block(pos, left, right, n);
+    pan_interleave(in, left, right, out, n);
+}
+
+/*
+ Worker of render_threads: renders one chunk of the input file
+ block by block, starting at a multiple of the block size, so the LFO sees
+ the same blocks as in the single-threaded loop. A failed seek or read
+ leaves count at the frames rendered, less than the chunk.
+ */
+static void * render_chunk(void * arg)
+{
+    RENDERTHREAD * t = (RENDERTHREAD *)arg;
+    sf_count_t done = 0, readcount;
+
+    if(sf_seek(t->infile, t->start, SEEK_SET) < 0){
+        t->count = 0;
+        return NULL;
+    }
+    lfo_seek(&t->lfo, t->start);
+    while(done < t->count
+          && (readcount = sf_read_float(t->infile, t->inbuffer,
+                                        t->count - done < t->nframes
+                                        ? t->count - done : t->nframes)) > 0){
+        if(t->kernel != NULL)
+            t->kernel(&t->lfo, t->inbuffer, t->outbuffer + 2 * done, readcount);
+        else
+            pan_block(&t->lfo, t->inbuffer, t->outbuffer + 2 * done, readcount,
+                      t->posbuffer, t->leftgain, t->rightgain);
+        done += readcount;
+    }
+    t->count = done;
+    return NULL;
+}
+
+/*
+ Rendering the input file with nthreads threads.
+ The file is processed in rounds: in each round every thread renders the
+ next chunk of about THREAD_FRAMES frames (whole blocks) into its own
+ buffer, then the chunks are written in order. The length of each chunk is
+ known from the length of the file, so a chunk that comes up short is an
+ error, not the end of the file. The output is bit-identical to the
+ single-threaded loop, since the LFO is a pure function of the frame
+ (lfo_seek).
+ Returning the frames rendered, or -1 for an error.
+ */
+sf_count_t render_threads(const char * infilename, SNDFILE * outfile, const LFO * lfo,
+                          int nthreads, long nframes)
+{
+    RENDERTHREAD threads[MAXTHREADS];
+    SF_INFO sfinfo;
+    sf_count_t round = 0, frames = 0, total = 0;
+    // frames per thread and round: whole blocks up to THREAD_FRAMES, or one bigger block
+    sf_count_t chunk = (THREAD_FRAMES > nframes ? THREAD_FRAMES / nframes : 1)
+                       * (sf_count_t)nframes;
+    RENDERKERNEL kernel = render_kernel(lfo, KERNEL_FLOAT);
+    int i, result = 0, finished = 0;
+
+    memset(threads, 0, sizeof(threads));
+    for(i = 0; i < nthreads; i++){
+        RENDERTHREAD * t = &threads[i];
+        memset(&sfinfo, 0, sizeof(sfinfo));
+        t->infile = sf_open(infilename, SFM_READ, &sfinfo);
+        total = sfinfo.frames;
+        t->lfo = *lfo;
+        t->kernel = kernel;
+        t->nframes = nframes;
+        t->inbuffer = (float *)malloc(nframes * sizeof(float));
+        t->posbuffer = (double *)malloc(nframes * sizeof(double));
+        t->leftgain = (float *)malloc(nframes * sizeof(float));
+        t->rightgain = (float *)malloc(nframes * sizeof(float));
+        t->outbuffer = (float *)malloc(2 * chunk * sizeof(float));
+        if(t->infile == NULL || t->inbuffer == NULL || t->posbuffer == NULL
+           || t->leftgain == NULL || t->rightgain == NULL || t->outbuffer == NULL){
+            nthreads = i + 1;
+            result = -1;
+            break;
+        }
+    }
+
+    while(result == 0 && !finished){
+        int started = 0;
+        for(i = 0; i < nthreads; i++){
+            threads[i].start = (round * nthreads + i) * chunk;
+            threads[i].count = total - threads[i].start < chunk ? total - threads[i].start : chunk;
+            if(threads[i].count <= 0)
+                break;  // nothing left for this thread
+            if(pthread_create(&threads[i].thread, NULL, render_chunk, &threads[i]) != 0){
+                result = -1;
+                break;
+            }
+            started++;
+        }
+        for(i = 0; i < started; i++)
+            pthread_join(threads[i].thread, NULL);
+        // write the chunks in order, up to the chunk at the end of the file
+        for(i = 0; i < started && result == 0; i++){
+            sf_count_t expected = total - threads[i].start < chunk
+                                  ? total - threads[i].start : chunk;
+            if(threads[i].count != expected
+               || sf_write_float(outfile, threads[i].outbuffer, 2 * threads[i].count)
+                  != 2 * threads[i].count)
+                result = -1;
+            frames += threads[i].count;
+        }
+        if(started < nthreads || (round + 1) * nthreads * chunk >= total)
+            finished = 1;
+        round++;
+    }
+
+    for(i = 0; i < nthreads; i++){
+        RENDERTHREAD * t = &threads[i];
+        if(t->infile != NULL)
+            sf_close(t->infile);
+        free(t->inbuffer);
+        free(t->posbuffer);
+        free(t->leftgain);
+        free(t->rightgain);
+        free(t->outbuffer);
+    }
+    return result == 0 ? frames : -1;
+}
+
+/*
+ Reader stage of the pipeline: fills the ring with mono blocks,
+ then an empty block at the end of the file.
+ */
+static void * pipe_read(void * arg)
+{
+    PIPESTAGE * stage = (PIPESTAGE *)arg;
+    PIPEBLOCK * block;
+
+    do {
+        block = (PIPEBLOCK *)rb_write_wait(stage->ring);
+        block->count = sf_read_float(stage->file, block->data, stage->nframes);
+        if(block->count < 0)
+            block->count = 0;
+        rb_write_commit(stage->ring);
+    } while(block->count > 0);
+    return NULL;
+}
+
+/*
+ Writer stage of the pipeline: writes stereo blocks until the empty block.
+ After a write error it keeps draining the ring, so the other stages don't block.
+ */
+static void * pipe_write(void * arg)
+{
+    PIPESTAGE * stage = (PIPESTAGE *)arg;
+    PIPEBLOCK * block;
+    long count;
+
+    do {
+        block = (PIPEBLOCK *)rb_read_wait(stage->ring);
+        count = block->count;
+        if(count > 0 && !stage->error
+           && sf_write_float(stage->file, block->data, 2 * count) != 2 * count)
+            stage->error = 1;
+        rb_read_release(stage->ring);
+    } while(count > 0);
+    return NULL;
+}
+
+/*
+ Rendering with a reader thread, a DSP stage on this thread and a writer
+ thread, connected by lock-free rings of PIPE_SLOTS blocks, so disk and CPU
+ work overlap. The blocks are the same as in the single-threaded loop, so
+ the output is identical.
+ Returning the frames rendered, or -1 for an error.
+ */
+static sf_count_t render_pipeline(SNDFILE * infile, SNDFILE * outfile, LFO * lfo,
+                                  PANBUFFERS * buf, FILE * fp, int binary, int srate)
+{
+    RINGBUF inring, outring;
+    PIPESTAGE reader, writer;
+    PIPEBLOCK * in, * out;
+    RENDERKERNEL kernel = fp == NULL ? render_kernel(lfo, KERNEL_FLOAT) : NULL;
+    sf_count_t frame = 0;
+    long count;
+
+    if(rb_init(&inring, PIPE_SLOTS, sizeof(PIPEBLOCK) + buf->nframes * sizeof(float)) != 0)
+        return -1;
+    if(rb_init(&outring, PIPE_SLOTS, sizeof(PIPEBLOCK) + 2 * buf->nframes * sizeof(float)) != 0){
+        rb_free(&inring);
+        return -1;
+    }
+    reader.file = infile;
+    reader.ring = &inring;
+    reader.nframes = buf->nframes;
+    reader.error = 0;
+    writer.file = outfile;
+    writer.ring = &outring;
+    writer.nframes = buf->nframes;
+    writer.error = 0;
+    if(pthread_create(&reader.thread, NULL, pipe_read, &reader) != 0){
+        rb_free(&inring);
+        rb_free(&outring);
+        return -1;
+    }
+    if(pthread_create(&writer.thread, NULL, pipe_write, &writer) != 0){
+        // drain the reader, then give up
+        do {
+            in = (PIPEBLOCK *)rb_read_wait(&inring);
+            count = in->count;
+            rb_read_release(&inring);
+        } while(count > 0);
+        pthread_join(reader.thread, NULL);
+        rb_free(&inring);
+        rb_free(&outring);
+        return -1;
+    }
+
+    // DSP stage
+    do {
+        in = (PIPEBLOCK *)rb_read_wait(&inring);
+        out = (PIPEBLOCK *)rb_write_wait(&outring);
+        count = out->count = in->count;
+        if(count > 0){
+            if(kernel != NULL)
+                kernel(lfo, in->data, out->data, count);
+            else
+                pan_block(lfo, in->data, out->data, count, buf->posbuffer, buf->leftgain, buf->rightgain);
+            if(fp != NULL)
+                export_block(fp, binary, buf->posbuffer, frame, count, srate);
+            frame += count;
+        }
+        rb_read_release(&inring);
+        rb_write_commit(&outring);
+    } while(count > 0);
+
+    pthread_join(reader.thread, NULL);
+    pthread_join(writer.thread, NULL);
+    rb_free(&inring);
+    rb_free(&outring);
+    return writer.error ? -1 : frame;
+}
+
+/*
+ Rendering 16, 24 or 32-bit PCM without going through float: the samples are
+ read as shorts and multiplied by Q15 gains (pan_interleave_s16), or read as
+ ints and multiplied by Q31 gains (pan_interleave_s32). The result is within one step of the float path, which
+ libsndfile scales by 1/32768 on reading and by 32767 on writing.
+ Returning the frames rendered.
+ */
+static sf_count_t render_integer(SNDFILE * infile, SNDFILE * outfile, LFO * lfo, PANBUFFERS * buf,
+                                 FILE * fp, int binary, int srate, int subtype,
+                                 RENDERSTATS * stats)
+{
+    short * in16 = (short *)buf->inpcm, * out16 = (short *)buf->outpcm;
+    short * left16 = (short *)buf->leftfix, * right16 = (short *)buf->rightfix;
+    sf_count_t frame = 0, readcount;
+
+    while((readcount = subtype == SF_FORMAT_PCM_16 ? sf_read_short(infile, in16, buf->nframes)
+                       : sf_read_int(infile, buf->inpcm, buf->nframes)) > 0){
+        stats_mark(stats, STAGE_DECODE);
+        lfo_tick_block(lfo, buf->posbuffer, readcount);
+        stats_mark(stats, STAGE_LFO);
+        if(subtype == SF_FORMAT_PCM_16){
+            constpower_block_q15(buf->posbuffer, left16, right16, readcount);
+            pan_interleave_s16(in16, left16, right16, out16, readcount);
+        }
+        else{
+            constpower_block_q31(buf->posbuffer, buf->leftfix, buf->rightfix, readcount);
+            pan_interleave_s32(buf->inpcm, buf->leftfix, buf->rightfix, buf->outpcm, readcount);
+        }
+        stats_mark(stats, STAGE_PAN);
+        if(subtype == SF_FORMAT_PCM_16)
+            sf_write_short(outfile, out16, 2 * readcount);
+        else
+            sf_write_int(outfile, buf->outpcm, 2 * readcount);
+        stats_mark(stats, STAGE_ENCODE);
+        if(fp != NULL){
+            export_block(fp, binary, buf->posbuffer, frame, readcount, srate);
+            stats_mark(stats, STAGE_EXPORT);
+        }
+        frame += readcount;
+    }
+    stats_mark(stats, STAGE_DECODE);  // the read at the end of the file
+    return frame;
+}
+
+/*
+ Rendering a WAV file through memory maps: samples are panned straight from
+ the mapped input into the mapped output, without libsndfile's read and write
+ copies. 16-bit samples go through the block buffers, scaled like libsndfile
+ does, or are panned as integers like render_integer does if intpcm is set.
+ Returning the frames rendered, -1 for an error, or -2 if the files
+ can't be mapped and the caller has to fall back to libsndfile.
+ */
+static sf_count_t render_mapped(const char * infilename, const char * outfilename, LFO * lfo,
+                                PANBUFFERS * buf, FILE * fp, int binary, SF_INFO * sfinfo,
+                                int intpcm, RENDERSTATS * stats)
+{
+    WAVMAP in, out;
+    sf_count_t frame;
+    RENDERKERNEL kernel = NULL;
+    int infloat, outfloat, outshort, integer;
+
+    if(wav_map_input(infilename, &in) != 0)
+        return -2;
+    if(in.channels != 1 || wav_map_output(outfilename, sfinfo, in.frames, &out) != 0){
+        wav_unmap(&in);
+        return -2;
+    }
+    // float samples are used in place only where they are aligned
+    infloat = in.subtype == SF_FORMAT_FLOAT && (uintptr_t)in.data % sizeof(float) == 0;
+    outfloat = out.subtype == SF_FORMAT_FLOAT && (uintptr_t)out.data % sizeof(float) == 0;
+    // without --export and --stats a fused kernel writes float or 16-bit
+    // samples to the map; --stats times the steps one by one instead
+    outshort = out.subtype == SF_FORMAT_PCM_16;
+    integer = intpcm && in.subtype == SF_FORMAT_PCM_16 && outshort;
+    if(fp == NULL && stats == NULL && !integer)
+        kernel = render_kernel(lfo, outshort ? KERNEL_PCM16 : KERNEL_FLOAT);
+    stats_mark(stats, STAGE_SETUP);
+
+    for(frame = 0; frame < in.frames; frame += buf->nframes){
+        long n = in.frames - frame < buf->nframes ? (long)(in.frames - frame) : buf->nframes;
+        const float * src = buf->inbuffer;
+        float * dst = outfloat ? (float *)out.data + 2 * frame : buf->outbuffer;
+
+        if(integer){
+            lfo_tick_block(lfo, buf->posbuffer, n);
+            stats_mark(stats, STAGE_LFO);
+            constpower_block_q15(buf->posbuffer, (short *)buf->leftfix, (short *)buf->rightfix, n);
+            pan_interleave_s16((const short *)in.data + frame, (const short *)buf->leftfix,
+                               (const short *)buf->rightfix, (short *)out.data + 2 * frame, n);
+            stats_mark(stats, STAGE_PAN);
+            if(fp != NULL){
+                export_block(fp, binary, buf->posbuffer, frame, n, sfinfo->samplerate);
+                stats_mark(stats, STAGE_EXPORT);
+            }
+            continue;
+        }
+        if(infloat)
+            src = (const float *)in.data + frame;
+        else if(in.subtype == SF_FORMAT_FLOAT)
+            memcpy(buf->inbuffer, (const float *)in.data + frame, n * sizeof(float));
+        else{
+            const short * samples = (const short *)in.data + frame;
+            for(long i = 0; i < n; i++)
+                buf->inbuffer[i] = samples[i] / 32768.0f;
+        }
+        stats_mark(stats, STAGE_DECODE);
+
+        if(kernel != NULL)
+            kernel(lfo, src, outshort ? (void *)((short *)out.data + 2 * frame) : (void *)dst, n);
+        else{
+            lfo_tick_block(lfo, buf->posbuffer, n);
+            stats_mark(stats, STAGE_LFO);
+            constpower_block(buf->posbuffer, buf->leftgain, buf->rightgain, n);
+            pan_interleave(src, buf->leftgain, buf->rightgain, dst, n);
+        }
+        stats_mark(stats, STAGE_PAN);
+
+        if(out.subtype == SF_FORMAT_FLOAT && !outfloat)
+            memcpy((float *)out.data + 2 * frame, dst, 2 * n * sizeof(float));
+        else if(outshort && kernel == NULL){
+            short * samples = (short *)out.data + 2 * frame;
+            for(long i = 0; i < 2 * n; i++){
+                long sample = lrintf(dst[i] * 32767.0f);
+                samples[i] = (short)(sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample);
+            }
+        }
+        stats_mark(stats, STAGE_ENCODE);
+        if(fp != NULL){
+            export_block(fp, binary, buf->posbuffer, frame, n, sfinfo->samplerate);
+            stats_mark(stats, STAGE_EXPORT);
+        }
+    }
+    frame = in.frames;  // wav_unmap clears the map
+    wav_unmap(&in);
+    if(wav_unmap(&out) != 0)
+        return -1;  // the output may not have reached the disk
+    return frame;
+}
@@ -0,0 +1,133 @@
+/*
+ringbuf.c -- single-producer/single-consumer lock-free ring buffer
+head and tail only ever grow; a slot index is the count modulo nslots.
+The producer publishes a slot with a release store of head, and the
+consumer gives it back with a release store of tail.
+A waiting side registers in sleepers before it checks the ring a last time
+and sleeps; the other side checks sleepers after its store, and only then
+takes the lock to wake it. The fences between the two make sure that one
+of them sees the other, so no wake-up is lost.
+*/
+
+#include <stdlib.h>
+#include <ringbuf.h>
+
+static void rb_wake(RINGBUF * rb);
+
+/*
+ Initializing a ring.
+ */
+int rb_init(RINGBUF * rb, unsigned long nslots, size_t slotsize)
+{
+    if(nslots == 0 || (nslots & (nslots - 1)) != 0)
+        return -1;
+    rb->slotsize = (slotsize + 63) & ~(size_t)63;  // keep every slot on its own cache lines
+    rb->nslots = nslots;
+    rb->slots = (char *)malloc(nslots * rb->slotsize);
+    if(rb->slots == NULL)
+        return -1;
+    atomic_init(&rb->head, 0);
+    atomic_init(&rb->tail, 0);
+    atomic_init(&rb->sleepers, 0);
+    if(pthread_mutex_init(&rb->lock, NULL) != 0){
+        free(rb->slots);
+        return -1;
+    }
+    if(pthread_cond_init(&rb->wake, NULL) != 0){
+        pthread_mutex_destroy(&rb->lock);
+        free(rb->slots);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ Releasing the memory of a ring.
+ */
+void rb_free(RINGBUF * rb)
+{
+    free(rb->slots);
+    rb->slots = NULL;
+    pthread_mutex_destroy(&rb->lock);
+    pthread_cond_destroy(&rb->wake);
+}
+
+void * rb_write_slot(RINGBUF * rb)
+{
+    unsigned long head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&rb->tail, memory_order_acquire);
+
+    if(head - tail == rb->nslots)
+        return NULL;  // full
+    return rb->slots + (head & (rb->nslots - 1)) * rb->slotsize;
+}
+
+void rb_write_commit(RINGBUF * rb)
+{
+    unsigned long head = atomic_load_explicit(&rb->head, memory_order_relaxed);
+
+    atomic_store_explicit(&rb->head, head + 1, memory_order_release);
+    rb_wake(rb);
+}
+
+void * rb_read_slot(RINGBUF * rb)
+{
+    unsigned long tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&rb->head, memory_order_acquire);
+
+    if(head == tail)
+        return NULL;  // empty
+    return rb->slots + (tail & (rb->nslots - 1)) * rb->slotsize;
+}
+
+void rb_read_release(RINGBUF * rb)
+{
+    unsigned long tail = atomic_load_explicit(&rb->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&rb->tail, tail + 1, memory_order_release);
+    rb_wake(rb);
+}
+
+/*
+ Waking the other side if it sleeps, after a commit or a release.
+ */
+static void rb_wake(RINGBUF * rb)
+{
+    atomic_thread_fence(memory_order_seq_cst);  // the store before this, then sleepers
+    if(atomic_load_explicit(&rb->sleepers, memory_order_relaxed) == 0)
+        return;
+    pthread_mutex_lock(&rb->lock);
+    pthread_cond_broadcast(&rb->wake);
+    pthread_mutex_unlock(&rb->lock);
+}
+
+/*
+ Spinning, then sleeping until get (rb_write_slot or rb_read_slot) has a slot.
+ */
+static void * rb_wait(RINGBUF * rb, void * (*get)(RINGBUF *))
+{
+    void * slot;
+    int i;
+
+    for(i = 0; i < RB_SPIN; i++)
+        if((slot = get(rb)) != NULL)
+            return slot;
+    pthread_mutex_lock(&rb->lock);
+    atomic_fetch_add_explicit(&rb->sleepers, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);  // sleepers, then the last check
+    while((slot = get(rb)) == NULL)
+        pthread_cond_wait(&rb->wake, &rb->lock);
+    atomic_fetch_sub_explicit(&rb->sleepers, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&rb->lock);
+    return slot;
+}
+
+void * rb_write_wait(RINGBUF * rb)
+{
+    return rb_wait(rb, rb_write_slot);
+}
+
+void * rb_read_wait(RINGBUF * rb)
+{
+    return rb_wait(rb, rb_read_slot);
+}
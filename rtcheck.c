@@ -0,0 +1,152 @@
+/*
+rtcheck.c -- worst-case timing of the realtime engine
+Runs ap_process on blocks of a fixed size, the way an audio callback would,
+while another thread keeps changing the parameters, and reports the mean,
+99th percentile and worst time per block against the time the block lasts.
+Fails (exit code 1) if the worst block took longer than its duration.
+Like an audio callback, the loop asks for realtime priority and locked
+memory; without them (no permission) the worst case includes preemptions.
+Usage: ./autopan-rtcheck [blocksize]
+Compile: make rtcheck
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <stdatomic.h>
+#include <engine.h>
+#include <pan.h>
+
+#define RT_SRATE (44100)
+#define RT_SECONDS (600)     // audio rendered by the check
+#define RT_WARMUP (100)      // blocks left out of the statistics
+#define RT_UPDATE_US (500)   // microseconds between two parameter changes
+
+#define RT_BURST (64)        // blocks between two waits of the audio loop
+
+static atomic_int done;      // set when the audio loop is finished
+static atomic_long changes;  // parameter changes made by the control thread
+
+static double rt_now(void);
+static int    rt_compare(const void * a, const void * b);
+
+/*
+ The control thread: random parameter changes until the audio loop is done.
+ */
+static void * rt_control(void * arg)
+{
+    AUTOPANNER * ap = (AUTOPANNER *)arg;
+    unsigned int seed = 1;
+    struct timespec pause = {0, RT_UPDATE_US * 1000};
+
+    while(!atomic_load(&done)){
+        switch(rand_r(&seed) % 4){
+        case 0: ap_setwidth(ap, 0.5 + 0.5 * rand_r(&seed) / RAND_MAX); break;
+        case 1: ap_setrate(ap, 10.0 * rand_r(&seed) / RAND_MAX); break;
+        case 2: ap_setphase(ap, 2.0 * M_PI * rand_r(&seed) / RAND_MAX); break;
+        default: ap_settype(ap, rand_r(&seed) % NLFOTYPES); break;
+        }
+        atomic_fetch_add(&changes, 1);
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+int main(int argc, char * argv[])
+{
+    long block = argc > 1 ? atol(argv[1]) : 256;
+    long nblocks, i;
+    float * in, * outl, * outr;
+    double * times, budget, mean = 0.0;
+    int result;
+    AUTOPANNER * ap;
+    pthread_t control;
+    struct sched_param param;
+    int realtime, locked;
+
+    if(block <= 0){
+        printf("Usage: %s [blocksize]\n", argv[0]);
+        return 1;
+    }
+    pan_init();
+    nblocks = (long)RT_SECONDS * RT_SRATE / block;
+    in = (float *)malloc(block * sizeof(float));
+    outl = (float *)malloc(block * sizeof(float));
+    outr = (float *)malloc(block * sizeof(float));
+    times = (double *)malloc(nblocks * sizeof(double));
+    ap = ap_new(RT_SRATE, block, SINE, 1.0, 1.0, 0.0);
+    if(in == NULL || outl == NULL || outr == NULL || times == NULL || ap == NULL){
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    for(i = 0; i < block; i++)
+        in[i] = (float)rand() / RAND_MAX - 0.5f;
+
+    if(pthread_create(&control, NULL, rt_control, ap) != 0){
+        printf("Error: unable to start the control thread\n");
+        return 1;
+    }
+    // the control thread keeps the normal priority
+    locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    realtime = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    if(!realtime || !locked)
+        printf("Note: running without %s; expect preemptions in the worst case.\n",
+               !realtime ? "realtime priority" : "locked memory");
+    for(i = 0; i < RT_WARMUP + nblocks; i++){
+        double start = rt_now();
+        ap_process(ap, in, outl, outr, block);
+        if(i >= RT_WARMUP)
+            times[i - RT_WARMUP] = rt_now() - start;
+        if(i % RT_BURST == RT_BURST - 1){
+            // wait like a callback between two buffers, so the control thread
+            // gets to run even on one core
+            struct timespec pause = {0, RT_UPDATE_US * 1000};
+            nanosleep(&pause, NULL);
+        }
+    }
+    atomic_store(&done, 1);
+    pthread_join(control, NULL);
+
+    for(i = 0; i < nblocks; i++)
+        mean += times[i];
+    mean /= nblocks;
+    qsort(times, nblocks, sizeof(double), rt_compare);
+    budget = (double)block / RT_SRATE;
+    printf("%ld blocks of %ld frames (%.1f us each), kernel %s, %ld parameter changes\n",
+           nblocks, block, budget * 1e6, pan_kernelname(), (long)atomic_load(&changes));
+    printf("mean %.2f us, p99 %.2f us, worst %.2f us (%.1f%% of the block)\n",
+           mean * 1e6, times[nblocks * 99 / 100] * 1e6, times[nblocks - 1] * 1e6,
+           100.0 * times[nblocks - 1] / budget);
+    result = times[nblocks - 1] > budget ? 1 : 0;
+
+    ap_free(ap);
+    free(in);
+    free(outl);
+    free(outr);
+    free(times);
+    return result;
+}
+
+/*
+ Monotonic time in seconds.
+ */
+static double rt_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int rt_compare(const void * a, const void * b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
@@ -0,0 +1,81 @@
+/*
+stats.c -- per-stage timing for the auto-panner
+A mark costs two clock_gettime calls, so the stages of the single-threaded
+loop are marked on every block.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stats.h>
+
+const char * stats_stagenames[NSTAGES] = {"setup", "decode", "lfo", "pan", "encode",
+                                          "export", "render", "finish"};
+
+/*
+ Reading the wall clock and the CPU time of the process in seconds.
+ */
+static void stats_now(double * wall, double * cpu)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    *wall = ts.tv_sec + ts.tv_nsec * 1e-9;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    *cpu = ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void stats_start(RENDERSTATS * stats)
+{
+    memset(stats, 0, sizeof(RENDERSTATS));
+    stats_now(&stats->lastwall, &stats->lastcpu);
+}
+
+void stats_mark(RENDERSTATS * stats, int stage)
+{
+    double wall, cpu;
+
+    if(stats == NULL)
+        return;
+    stats_now(&wall, &cpu);
+    stats->wall[stage] += wall - stats->lastwall;
+    stats->cpu[stage] += cpu - stats->lastcpu;
+    stats->lastwall = wall;
+    stats->lastcpu = cpu;
+}
+
+/*
+ Printing the stats; stages that took no time are left out of the table.
+ */
+void stats_print(FILE * fp, const RENDERSTATS * stats, long long frames, int samplerate, int json)
+{
+    double wall = 0.0, cpu = 0.0, audio = samplerate > 0 ? (double)frames / samplerate : 0.0;
+    int i;
+
+    for(i = 0; i < NSTAGES; i++){
+        wall += stats->wall[i];
+        cpu += stats->cpu[i];
+    }
+
+    if(json){
+        fprintf(fp, "{\"frames\": %lld, \"audio_seconds\": %.6f, \"wall_seconds\": %.6f, "
+                "\"cpu_seconds\": %.6f, \"realtime\": %.3f, \"stages\": {",
+                frames, audio, wall, cpu, wall > 0.0 ? audio / wall : 0.0);
+        for(i = 0; i < NSTAGES; i++)
+            fprintf(fp, "%s\"%s\": {\"wall\": %.6f, \"cpu\": %.6f}", i ? ", " : "",
+                    stats_stagenames[i], stats->wall[i], stats->cpu[i]);
+        fprintf(fp, "}}\n");
+        return;
+    }
+
+    fprintf(fp, "%-8s %10s %10s %7s\n", "stage", "wall (s)", "cpu (s)", "wall %");
+    for(i = 0; i < NSTAGES; i++){
+        if(stats->wall[i] == 0.0 && stats->cpu[i] == 0.0)
+            continue;
+        fprintf(fp, "%-8s %10.4f %10.4f %6.1f%%\n", stats_stagenames[i], stats->wall[i],
+                stats->cpu[i], wall > 0.0 ? 100.0 * stats->wall[i] / wall : 0.0);
+    }
+    fprintf(fp, "%-8s %10.4f %10.4f\n", "total", wall, cpu);
+    fprintf(fp, "%lld frames, %.2f seconds of audio, %.1fx realtime\n",
+            frames, audio, wall > 0.0 ? audio / wall : 0.0);
+}
@@ -0,0 +1,258 @@
+/*
+tune.c -- block size auto-tuning for the auto-panner
+Small blocks cost a libsndfile call (and sometimes a system call) per few KB,
+large blocks push the buffers of a block out of the cache. The block sizes
+worth timing are the ones whose buffers fit between L1 and L2.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sndfile.h>
+#include <lfo.h>
+#include <kernels.h>
+#include <render.h>
+#include <tune.h>
+#ifdef __APPLE__
+#include <stdint.h>
+#include <sys/sysctl.h>
+#endif
+
+// bytes of buffers per frame of a block: mono in and stereo out, all the
+// fused kernel of the default render touches
+#define TUNE_FRAMEBYTES (sizeof(float) + 2 * sizeof(float))
+#define TUNE_L1 (32 * 1024)      // cache sizes assumed if they are unknown
+#define TUNE_L2 (1024 * 1024)
+
+static double tune_now(void);
+static int    tune_scratch(const char * filename);
+static double tune_run(const char * infilename, const char * outfilename, long nframes);
+
+/*
+ Reading the size of a cache from sysfs: the index directories of cpu0
+ list the level, type and size ("48K") of each cache.
+ */
+static long cache_sysfs(int level)
+{
+    char path[128], text[64];
+    FILE * fp;
+    long size = 0;
+
+    for(int i = 0; size == 0; i++){
+        int thislevel = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+        if((fp = fopen(path, "r")) == NULL)
+            break;
+        if(fscanf(fp, "%d", &thislevel) != 1)
+            thislevel = 0;
+        fclose(fp);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+        if(thislevel != level || (fp = fopen(path, "r")) == NULL)
+            continue;
+        if(fscanf(fp, "%63s", text) != 1 || strcmp(text, "Instruction") == 0){
+            fclose(fp);
+            continue;  // the L1 instruction cache doesn't hold our buffers
+        }
+        fclose(fp);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+        if((fp = fopen(path, "r")) == NULL)
+            continue;
+        if(fscanf(fp, "%ld%63s", &size, text) < 1)
+            size = 0;
+        else if(text[0] == 'K')
+            size *= 1024;
+        else if(text[0] == 'M')
+            size *= 1024 * 1024;
+        fclose(fp);
+    }
+    return size;
+}
+
+/*
+ Size of the level 1 data cache or of the level 2 cache in bytes, or 0.
+ */
+long cache_size(int level)
+{
+    long size = 0;
+
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+    size = sysconf(level == 1 ? _SC_LEVEL1_DCACHE_SIZE : _SC_LEVEL2_CACHE_SIZE);
+#elif defined(__APPLE__)
+    int64_t value = 0;
+    size_t length = sizeof(value);
+    if(sysctlbyname(level == 1 ? "hw.l1dcachesize" : "hw.l2cachesize", &value, &length, NULL, 0) == 0)
+        size = (long)value;
+#endif
+    if(size <= 0)
+        size = cache_sysfs(level);
+    return size > 0 ? size : 0;
+}
+
+/*
+ Finding the fastest block size, from the cache file or by timing.
+ */
+long tune_blocksize(void)
+{
+    char cachename[1024], inname[1024], outname[1024];
+    const char * home = getenv("HOME");
+    const char * tmpdir = getenv("TMPDIR");
+    long l1 = cache_size(1), l2 = cache_size(2);
+    long lo, hi, nframes, best = NFRAMES;
+    double besttime = 0.0;
+    FILE * fp;
+    int fd;
+
+    // reuse an earlier choice made for the same caches
+    cachename[0] = '\0';
+    if(home != NULL && home[0] != '\0'){
+        long cached, cachedl1, cachedl2;
+        snprintf(cachename, sizeof(cachename), "%s/%s", home, TUNE_FILE);
+        int version;
+        if((fp = fopen(cachename, "r")) != NULL){
+            int found = fscanf(fp, "%ld %ld %ld %d", &cached, &cachedl1, &cachedl2, &version) == 4
+                        && version == TUNE_VERSION && cachedl1 == l1 && cachedl2 == l2
+                        && cached >= MINFRAMES && cached <= MAXFRAMES;
+            fclose(fp);
+            if(found)
+                return cached;
+        }
+    }
+
+    // from the largest block that fits in L1 to the largest that fits in L2
+    for(lo = 256; lo * 2 * TUNE_FRAMEBYTES <= (size_t)(l1 ? l1 : TUNE_L1); lo *= 2)
+        ;
+    for(hi = lo; hi * 2 * TUNE_FRAMEBYTES <= (size_t)(l2 ? l2 : TUNE_L2) && hi * 2 <= MAXFRAMES; hi *= 2)
+        ;
+    if(hi < 4 * lo)
+        hi = 4 * lo;
+
+    if(tmpdir == NULL || tmpdir[0] == '\0')
+        tmpdir = "/tmp";
+    snprintf(inname, sizeof(inname), "%s/autopan-tuneXXXXXX", tmpdir);
+    snprintf(outname, sizeof(outname), "%s/autopan-tuneXXXXXX", tmpdir);
+    if((fd = mkstemp(inname)) < 0)
+        return NFRAMES;
+    close(fd);
+    if((fd = mkstemp(outname)) < 0){
+        remove(inname);
+        return NFRAMES;
+    }
+    close(fd);
+
+    printf("Tuning the block size (L1 %ld KB, L2 %ld KB):\n", l1 / 1024, l2 / 1024);
+    if(tune_scratch(inname) == 0){
+        for(nframes = lo; nframes <= hi; nframes *= 2){
+            double seconds = tune_run(inname, outname, nframes);
+            if(seconds <= 0.0)
+                continue;
+            printf("  %7ld frames: %8.2f ms\n", nframes, seconds * 1000.0);
+            if(besttime == 0.0 || seconds < besttime){
+                besttime = seconds;
+                best = nframes;
+            }
+        }
+    }
+    remove(inname);
+    remove(outname);
+    if(besttime == 0.0){
+        printf("Error: unable to time the block sizes, using %d.\n", NFRAMES);
+        return NFRAMES;
+    }
+
+    printf("Block size: %ld frames\n", best);
+    if(cachename[0] != '\0' && (fp = fopen(cachename, "w")) != NULL){
+        fprintf(fp, "%ld %ld %ld %d\n", best, l1, l2, TUNE_VERSION);
+        fclose(fp);
+    }
+    return best;
+}
+
+/*
+ Writing the scratch input: TUNE_FRAMES frames of a 16-bit mono sine.
+ Returning 0 for success or -1.
+ */
+static int tune_scratch(const char * filename)
+{
+    SF_INFO sfinfo;
+    SNDFILE * file;
+    float block[NFRAMES];
+    int result = 0;
+
+    memset(&sfinfo, 0, sizeof(sfinfo));
+    sfinfo.samplerate = 44100;
+    sfinfo.channels = 1;
+    sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    if((file = sf_open(filename, SFM_WRITE, &sfinfo)) == NULL)
+        return -1;
+    for(long frame = 0; frame < TUNE_FRAMES && result == 0; frame += NFRAMES){
+        for(int i = 0; i < NFRAMES; i++)
+            block[i] = (float)(0.5 * sin(2.0 * M_PI * 440.0 * (frame + i) / 44100.0));
+        if(sf_write_float(file, block, NFRAMES) != NFRAMES)
+            result = -1;
+    }
+    sf_close(file);
+    return result;
+}
+
+/*
+ Timing the render of the scratch file with blocks of nframes frames, the
+ fastest of TUNE_RUNS runs. The blocks go through the fused kernel, like
+ the default render does. Returning the time in seconds, or 0 for an error.
+ */
+static double tune_run(const char * infilename, const char * outfilename, long nframes)
+{
+    PANBUFFERS buf;
+    double best = 0.0;
+
+    if(panbuffers_alloc(&buf, nframes) != 0)
+        return 0.0;
+    for(int run = 0; run < TUNE_RUNS; run++){
+        SF_INFO sfinfo;
+        SNDFILE * infile, * outfile;
+        sf_count_t readcount;
+        LFO lfo;
+        RENDERKERNEL kernel;
+        double start = tune_now(), seconds;
+
+        memset(&sfinfo, 0, sizeof(sfinfo));
+        if((infile = sf_open(infilename, SFM_READ, &sfinfo)) == NULL)
+            break;
+        sfinfo.channels = 2;
+        if((outfile = sf_open(outfilename, SFM_WRITE, &sfinfo)) == NULL){
+            sf_close(infile);
+            break;
+        }
+        if(lfo_init(&lfo, SINE, 1.0, 1.0, 0.0, sfinfo.samplerate) != 0){
+            sf_close(infile);
+            sf_close(outfile);
+            best = 0.0;
+            break;
+        }
+        kernel = render_kernel(&lfo, KERNEL_FLOAT);
+        while((readcount = sf_read_float(infile, buf.inbuffer, nframes)) > 0){
+            kernel(&lfo, buf.inbuffer, buf.outbuffer, readcount);
+            sf_write_float(outfile, buf.outbuffer, 2 * readcount);
+        }
+        sf_close(infile);
+        sf_close(outfile);
+        seconds = tune_now() - start;
+        if(best == 0.0 || seconds < best)
+            best = seconds;
+    }
+    panbuffers_free(&buf);
+    return best;
+}
+
+/*
+ Monotonic time in seconds.
+ */
+static double tune_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
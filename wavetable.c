@@ -0,0 +1,145 @@
+/*
+wavetable.c -- wavetables for the auto-panner LFO
+Builds the sine, square, sawtooth and triangle tables, either exact or
+band-limited by additive synthesis, and loads custom shapes from
+breakpoint files.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include <breakpoints.h>
+#include <lfo.h>
+#include <wavetable.h>
+
+static WAVETABLE tables[2][TRIANGLE + 1];  // [bandlimited][type]
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void wt_build(void);                       // fill all the built-in tables
+static double wt_exact(int type, double phase);   // value of a waveform at a phase
+static double wt_bandlimited(int type, double phase);
+
+/*
+ Returning the table for an LFO type; the first call on any thread builds
+ the tables, the others wait for it.
+ */
+const WAVETABLE * wt_get(int type, int bandlimited)
+{
+    if(type < SINE || type > TRIANGLE)
+        return NULL;
+    pthread_once(&tables_once, wt_build);
+    return &tables[bandlimited ? 1 : 0][type];
+}
+
+/*
+ Loading a custom LFO shape from a breakpoint text file.
+ */
+WAVETABLE * wt_load(FILE * fp)
+{
+    BREAKPOINT * points;
+    unsigned long npoints = 0, span = 1;
+    WAVETABLE * wt;
+    double cycle;
+
+    points = get_breakpoints(fp, &npoints);
+    if(points == NULL)
+        return NULL;
+    if(npoints < 2 || points[0].time != 0.0 || points[npoints-1].time <= 0.0){
+        printf("Error: a shape needs at least two breakpoints from time 0.0\n");
+        free(points);
+        return NULL;
+    }
+    if(!inrange(points, -1.0, 1.0, npoints)){
+        printf("Error: shape values must be between -1.0 and 1.0\n");
+        free(points);
+        return NULL;
+    }
+    wt = (WAVETABLE *)malloc(sizeof(WAVETABLE));
+    if(wt == NULL){
+        free(points);
+        return NULL;
+    }
+    // the whole file is one cycle
+    cycle = points[npoints-1].time;
+    for(int i = 0; i < WT_SIZE; i++)
+        wt->table[i] = (float)val_at_brktime_from(points, npoints, cycle * i / WT_SIZE, &span);
+    wt->table[WT_SIZE] = wt->table[0];
+    free(points);
+    return wt;
+}
+
+/*
+ Filling all the built-in tables.
+ */
+static void wt_build(void)
+{
+    static double partials[WT_SIZE];
+
+    for(int type = SINE; type <= TRIANGLE; type++){
+        double peak = 0.0;
+        for(int i = 0; i < WT_SIZE; i++){
+            double phase = (double)i / WT_SIZE;
+            tables[0][type].table[i] = (float)wt_exact(type, phase);
+            partials[i] = wt_bandlimited(type, phase);
+            peak = fmax(peak, fabs(partials[i]));
+        }
+        // normalize, so the band-limited shapes still pan the full width
+        for(int i = 0; i < WT_SIZE; i++)
+            tables[1][type].table[i] = (float)(partials[i] / peak);
+        tables[0][type].table[WT_SIZE] = tables[0][type].table[0];
+        tables[1][type].table[WT_SIZE] = tables[1][type].table[0];
+    }
+}
+
+/*
+ Value of a waveform at a phase in cycles, the same shapes lfo_tick_block makes.
+ */
+static double wt_exact(int type, double phase)
+{
+    switch(type){
+    case SINE:
+        return sin(2.0 * M_PI * phase);
+    case SQUARE:
+        return phase < 0.5 ? 1.0 : -1.0;
+    case SAWTOOTH:
+        return 2.0 * phase - 1.0;
+    default: // TRIANGLE
+        if(phase < 0.25)
+            return 4.0 * phase;
+        if(phase < 0.75)
+            return 2.0 - 4.0 * phase;
+        return 4.0 * phase - 4.0;
+    }
+}
+
+/*
+ Value of a waveform summed from its Fourier series up to WT_HARMONICS.
+ The Lanczos sigma factors damp the Gibbs ripple next to the edges;
+ wt_build scales what overshoot remains back to -1.0 ... 1.0.
+ */
+static double wt_bandlimited(int type, double phase)
+{
+    double x = 2.0 * M_PI * phase;
+    double sum = 0.0;
+
+    if(type == SINE)
+        return sin(x);
+    for(int n = 1; n <= WT_HARMONICS; n++){
+        double sigma = n == 1 ? 1.0 : sin(M_PI * n / (WT_HARMONICS + 1)) / (M_PI * n / (WT_HARMONICS + 1));
+        switch(type){
+        case SQUARE:
+            if(n % 2)
+                sum += sigma * 4.0 / (M_PI * n) * sin(n * x);
+            break;
+        case SAWTOOTH:
+            // rising from -1 to 1 over the cycle, like 2 * phase - 1
+            sum -= sigma * 2.0 / (M_PI * n) * sin(n * x);
+            break;
+        default: // TRIANGLE
+            if(n % 2)
+                sum += sigma * 8.0 / (M_PI * M_PI * n * n) * ((n / 2) % 2 ? -1.0 : 1.0) * sin(n * x);
+            break;
+        }
+    }
+    return sum;
+}